@@ -11,300 +11,7296 @@
 #include <condition_variable> // for signaling between threads
 #include <atomic> // for atomic operations
 #include <algorithm> // for std::min
+#include <deque> // per-role player queues
+#include <cmath> // for std::sqrt
+#include <cstdlib> // std::atof for command-line values
+#include <cstring> // memchr
+#include <climits> // INT64_MIN
+#include <set> // ordered free list for round-robin selection
+#include <unordered_set> // baseline for the duplicate-join benchmark
+#include <queue> // heaps for instance selection
+#include <cstdint> // fixed-width integers for the event log format
+#include <iterator> // reading the event log into memory
+#include <memory> // std::unique_ptr for the dashboard's per-instance arrays
+#include <csignal> // stop and stats-dump signals in daemon mode
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h> // GetThreadTimes
+#include <psapi.h> // GetProcessMemoryInfo
+#pragma comment(lib, "psapi.lib")
+#pragma comment(lib, "Synchronization.lib") // WaitOnAddress
+#else
+#include <time.h> // clock_gettime
+#include <unistd.h> // write() from the signal handler, sysconf
+#include <sys/mman.h> // mmap for join files
+#ifdef __linux__
+#include <sys/syscall.h> // futex
+#include <linux/futex.h> // FUTEX_WAIT_PRIVATE / FUTEX_WAKE_PRIVATE
+#include <pthread.h> // pthread_setaffinity_np for shadow engines
+#include <sys/inotify.h> // config.txt hot reload
+#include <poll.h> // waiting on the inotify descriptor with a timeout
+#endif
+#include <sys/stat.h> // fstat
+#include <fcntl.h> // open
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h> // SSE2 column scans in the event log reader
+#define LFG_HAVE_SSE2 1
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+enum Role { TANK = 0, HEALER = 1, DPS = 2, ROLE_COUNT = 3 };
+
+// How formParty picks players out of each role queue
+enum class FairnessPolicy {
+    Legacy,     // newest first, which is what plain counter decrements amounted to
+    StrictFifo, // oldest join time first, priority ignored
+    Aging       // highest (priorityBoost + agingRate * wait) first
+};
+
+// Role flags for players who will fill more than one role
+const uint8_t ROLE_FLAG_TANK = 1;
+const uint8_t ROLE_FLAG_HEALER = 2;
+const uint8_t ROLE_FLAG_DPS = 4;
+
+struct Player {
+    int id;
+    Role role; // the role queue the player waits in
+    Clock::time_point joinTime;
+    double priorityBoost; // seconds of wait credited up front
+    uint8_t roleFlags; // every role the player signed up for
+    uint8_t bracket; // skill/gear bracket from the join record
+    uint16_t rating; // matchmaking rating, 0-3999, used by skill matching
+    uint32_t joinStamp; // set when queued; an entry is live while queuedIds holds this stamp for its id
+
+    Player(int playerId, Role playerRole, Clock::time_point joined, double boost = 0.0)
+        : id(playerId), role(playerRole), joinTime(joined), priorityBoost(boost),
+        roleFlags(static_cast<uint8_t>(1 << playerRole)), bracket(0), rating(0), joinStamp(0) {}
+};
+
+const int PARTY_SIZE = 5;
+
+// 32-bit generational handle into the player slot map: the low 22 bits pick the
+// slot and the high 10 bits hold the slot's generation when the handle was issued.
+// Handle 0 is never issued.
+typedef uint32_t PlayerHandle;
+const int HANDLE_INDEX_BITS = 22;
+const uint32_t HANDLE_INDEX_MASK = (1u << HANDLE_INDEX_BITS) - 1;
+const uint32_t HANDLE_GENERATION_MASK = (1u << (32 - HANDLE_INDEX_BITS)) - 1;
+
+// Records of matched players, addressed by handle. Removing a player bumps the
+// slot's generation, so a handle kept past removal resolves to nullptr instead of
+// to whoever reuses the slot. A slot whose generation has used up its 10 bits is
+// retired rather than wrapped, since wrapping would make handles from 1023 reuses
+// ago valid again; that costs one slot per 1023 players through it. Retired slots
+// are never reclaimed, so the 4M-slot index space lasts about 4.3 billion matched
+// players per process (and about 170 MB of retired slots); past that insert
+// returns 0, and formParty checks hasRoom first so no player is ever dropped.
+struct PlayerSlotMap {
+    struct Slot {
+        Player player;
+        uint32_t generation;
+        bool live;
+        Slot(const Player& p) : player(p), generation(1), live(false) {}
+    };
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+    size_t liveCount = 0;
+    size_t retiredSlots = 0; // slots with every generation spent, never handed out again
+
+    // Whether `count` more players fit, counting free slots and unused indexes
+    bool hasRoom(size_t count) const {
+        return freeSlots.size() + (static_cast<size_t>(HANDLE_INDEX_MASK) + 1 - slots.size()) >= count;
+    }
+
+    PlayerHandle insert(const Player& player) {
+        uint32_t index;
+        if (!freeSlots.empty()) {
+            index = freeSlots.back();
+            freeSlots.pop_back();
+            slots[index].player = player;
+        }
+        else {
+            if (slots.size() > HANDLE_INDEX_MASK) return 0;
+            index = static_cast<uint32_t>(slots.size());
+            slots.push_back(Slot(player));
+        }
+        slots[index].live = true;
+        liveCount++;
+        return (slots[index].generation << HANDLE_INDEX_BITS) | index;
+    }
+
+    const Player* get(PlayerHandle handle) const {
+        uint32_t index = handle & HANDLE_INDEX_MASK;
+        if (index >= slots.size()) return nullptr;
+        const Slot& slot = slots[index];
+        if (!slot.live || slot.generation != handle >> HANDLE_INDEX_BITS) return nullptr;
+        return &slot.player;
+    }
+
+    bool remove(PlayerHandle handle) {
+        if (!get(handle)) return false;
+        uint32_t index = handle & HANDLE_INDEX_MASK;
+        Slot& slot = slots[index];
+        slot.live = false;
+        liveCount--;
+        if (slot.generation == HANDLE_GENERATION_MASK) {
+            retiredSlots++;
+            return true;
+        }
+        slot.generation++;
+        freeSlots.push_back(index);
+        return true;
+    }
+};
+
+// Set of player ids currently queued or in a party, used to turn away retried
+// joins. Open addressing with linear probing over a flat array of id + 1 (0 marks
+// an empty slot), kept 35-70% full, so an id costs 6-12 bytes (about 8.4 in
+// --bench-joins) and a lookup is one hash and usually one cache line. Erase shifts
+// later entries back instead of leaving tombstones, so long-running churn never
+// degrades probes. Id -1 would be the empty key, so it is never stored: insert
+// rejects it and contains/erase report it absent. A stamped index also keeps a
+// 32-bit value per id in a parallel array, doubling the cost, so the role queues
+// can tell the entry of the current join from ones left by earlier joins.
+struct PlayerIdIndex {
+    std::vector<uint32_t> slots;
+    std::vector<uint32_t> stamps; // parallel to slots when stamped, else empty
+    size_t count = 0;
+    int shift = 32; // 32 - log2 of the slot count
+    bool stamped;
+
+    explicit PlayerIdIndex(bool withStamps = false) : stamped(withStamps) { rehash(16); }
+
+    size_t size() const { return count; }
+    size_t memoryBytes() const { return (slots.capacity() + stamps.capacity()) * sizeof(uint32_t); }
+
+    void reserve(size_t entries) {
+        size_t capacity = slots.size();
+        while (entries * 10 > capacity * 7) capacity *= 2;
+        if (capacity != slots.size()) rehash(capacity);
+    }
+
+    bool contains(int id) const {
+        return find(id) != SIZE_MAX;
+    }
+
+    // Present with this stamp; stamped indexes only
+    bool contains(int id, uint32_t stamp) const {
+        size_t i = find(id);
+        return i != SIZE_MAX && stamps[i] == stamp;
+    }
+
+    // False if the id is already present, or is -1
+    bool insert(int id, uint32_t stamp = 0) {
+        if (id == -1) return false;
+        if ((count + 1) * 10 > slots.size() * 7) rehash(slots.size() * 2);
+        uint32_t key = static_cast<uint32_t>(id) + 1;
+        size_t mask = slots.size() - 1;
+        size_t i = home(key);
+        for (; slots[i] != 0; i = (i + 1) & mask) {
+            if (slots[i] == key) return false;
+        }
+        slots[i] = key;
+        if (stamped) stamps[i] = stamp;
+        count++;
+        return true;
+    }
+
+    bool erase(int id) {
+        size_t i = find(id);
+        if (i == SIZE_MAX) return false;
+        eraseAt(i);
+        return true;
+    }
+
+    // Erases the id only if it holds this stamp; stamped indexes only
+    bool erase(int id, uint32_t stamp) {
+        size_t i = find(id);
+        if (i == SIZE_MAX || stamps[i] != stamp) return false;
+        eraseAt(i);
+        return true;
+    }
+
+    // Slot holding the id, or SIZE_MAX
+    size_t find(int id) const {
+        if (id == -1) return SIZE_MAX;
+        uint32_t key = static_cast<uint32_t>(id) + 1;
+        size_t mask = slots.size() - 1;
+        for (size_t i = home(key); slots[i] != 0; i = (i + 1) & mask) {
+            if (slots[i] == key) return i;
+        }
+        return SIZE_MAX;
+    }
+
+    void eraseAt(size_t hole) {
+        size_t mask = slots.size() - 1;
+        // Pull back any later entry in the run whose home slot is at or before the hole
+        for (size_t next = (hole + 1) & mask; slots[next] != 0; next = (next + 1) & mask) {
+            if (((next - home(slots[next])) & mask) >= ((next - hole) & mask)) {
+                slots[hole] = slots[next];
+                if (stamped) stamps[hole] = stamps[next];
+                hole = next;
+            }
+        }
+        slots[hole] = 0;
+        count--;
+    }
+
+    size_t home(uint32_t key) const { // Fibonacci hashing, so strided ids spread out too
+        return static_cast<uint32_t>(key * 2654435769u) >> shift;
+    }
+
+    void rehash(size_t capacity) {
+        std::vector<uint32_t> old;
+        std::vector<uint32_t> oldStamps;
+        old.swap(slots);
+        oldStamps.swap(stamps);
+        slots.assign(capacity, 0);
+        if (stamped) stamps.assign(capacity, 0);
+        shift = 32;
+        for (size_t c = capacity; c > 1; c >>= 1) shift--;
+        size_t mask = capacity - 1;
+        for (size_t j = 0; j < old.size(); j++) {
+            if (old[j] == 0) continue;
+            size_t i = home(old[j]);
+            while (slots[i] != 0) i = (i + 1) & mask;
+            slots[i] = old[j];
+            if (stamped) stamps[i] = oldStamps[j];
+        }
+    }
+};
+
+// Trivially copyable so it moves between queue, instance and completion without allocating
+struct Party {
+    int id = 0;
+    PlayerHandle members[PARTY_SIZE] = {}; // 1 tank, 1 healer, 3 dps, records in playerSlots
+    int dungeonType = 0;
+    int crashes = 0; // runs lost to instance crashes
+    Clock::time_point crashedAt; // when the last crash sent the party back to the queue
+};
+
+// Players waiting for one role. Aging keys are boost - agingRate * joinTime, which
+// orders players the same way as boost + agingRate * (now - joinTime) for every
+// "now", so the heap never needs re-keying as time passes.
+struct RoleQueue {
+    FairnessPolicy policy;
+    double agingRate;
+    std::deque<Player> fifo; // Legacy and StrictFifo
+    std::vector<std::pair<double, Player>> heap; // Aging
+
+    RoleQueue() : policy(FairnessPolicy::Aging), agingRate(1.0) {}
+
+    size_t size() const {
+        return policy == FairnessPolicy::Aging ? heap.size() : fifo.size();
+    }
+
+    void push(const Player& player) {
+        if (policy == FairnessPolicy::Aging) {
+            double joined = std::chrono::duration<double>(player.joinTime.time_since_epoch()).count();
+            heap.emplace_back(player.priorityBoost - agingRate * joined, player);
+            std::push_heap(heap.begin(), heap.end(), heapOrder);
+        }
+        else {
+            fifo.push_back(player);
+        }
+    }
+
+    Player pop() {
+        if (policy == FairnessPolicy::Aging) {
+            std::pop_heap(heap.begin(), heap.end(), heapOrder);
+            Player player = heap.back().second;
+            heap.pop_back();
+            return player;
+        }
+        if (policy == FairnessPolicy::Legacy) {
+            Player player = fifo.back();
+            fifo.pop_back();
+            return player;
+        }
+        Player player = fifo.front();
+        fifo.pop_front();
+        return player;
+    }
+
+    // Adds a large batch at once: O(n) heapify for aging, and for the FIFO policies
+    // the batch is put in join-time order first since files need not be sorted
+    void pushBulk(std::vector<Player>& players) {
+        if (policy == FairnessPolicy::Aging) {
+            heap.reserve(heap.size() + players.size());
+            for (const auto& player : players) {
+                double joined = std::chrono::duration<double>(player.joinTime.time_since_epoch()).count();
+                heap.emplace_back(player.priorityBoost - agingRate * joined, player);
+            }
+            std::make_heap(heap.begin(), heap.end(), heapOrder);
+            return;
+        }
+        std::sort(players.begin(), players.end(), [](const Player& a, const Player& b) {
+            if (a.joinTime != b.joinTime) return a.joinTime < b.joinTime;
+            return a.id < b.id;
+        });
+        fifo.insert(fifo.end(), players.begin(), players.end());
+    }
+
+    void clear() {
+        fifo.clear();
+        heap.clear();
+    }
+
+    // Drops every player `keep` rejects in one O(n) pass, keeping the order
+    template <typename Keep>
+    void retain(Keep keep) {
+        if (policy == FairnessPolicy::Aging) {
+            heap.erase(std::remove_if(heap.begin(), heap.end(), [&](const std::pair<double, Player>& entry) {
+                return !keep(entry.second);
+            }), heap.end());
+            std::make_heap(heap.begin(), heap.end(), heapOrder);
+            return;
+        }
+        fifo.erase(std::remove_if(fifo.begin(), fifo.end(), [&](const Player& player) { return !keep(player); }), fifo.end());
+    }
+
+    // Max-heap on key, ties broken by the lower player id
+    static bool heapOrder(const std::pair<double, Player>& a, const std::pair<double, Player>& b) {
+        if (a.first != b.first) return a.first < b.first;
+        return a.second.id > b.second.id;
+    }
+};
+
+// Players waiting for one role when skill matching is on, bucketed by rating. Each
+// bucket is a FIFO and a Fenwick tree over the bucket sizes counts any rating range
+// in O(log buckets), so a search rejects hopeless windows without touching players.
+// Removal is lazy: a matched or departed player stays put until it reaches the front
+// of its bucket or of byArrival, and every walk is given the test for a live entry.
+// Sizes and range counts therefore include such entries and are upper bounds.
+struct SkillIndex {
+    static const int bucketWidth = 25;
+    static const int bucketCount = 160; // ratings 0-3999
+    std::vector<std::deque<Player>> buckets;
+    std::vector<int> fenwick; // 1-based, entries per bucket
+    std::deque<Player> byArrival; // same players in join order, for picking anchors
+
+    SkillIndex() : buckets(bucketCount), fenwick(bucketCount + 1, 0) {}
+
+    static int bucketOf(int rating) {
+        return std::min(bucketCount - 1, std::max(0, rating / bucketWidth));
+    }
+
+    size_t size() const { return byArrival.size(); }
+
+    void push(const Player& player) {
+        int bucket = bucketOf(player.rating);
+        buckets[bucket].push_back(player);
+        add(bucket, 1);
+        byArrival.push_back(player);
+    }
+
+    void add(int bucket, int delta) {
+        for (int i = bucket + 1; i <= bucketCount; i += i & -i) fenwick[i] += delta;
+    }
+
+    // Entries in buckets [first, last]
+    int countRange(int first, int last) const {
+        int count = 0;
+        for (int i = last + 1; i > 0; i -= i & -i) count += fenwick[i];
+        for (int i = first; i > 0; i -= i & -i) count -= fenwick[i];
+        return count;
+    }
+
+    template <typename Live>
+    void trimFront(int bucket, Live live) {
+        while (!buckets[bucket].empty() && !live(buckets[bucket].front())) {
+            buckets[bucket].pop_front();
+            add(bucket, -1);
+        }
+    }
+
+    // Up to `limit` live players from the front of byArrival, oldest first
+    template <typename Live>
+    int oldest(int limit, Live live, const Player** out) {
+        while (!byArrival.empty() && !live(byArrival.front())) byArrival.pop_front();
+        int found = 0;
+        for (size_t i = 0; i < byArrival.size() && found < limit; i++) {
+            if (live(byArrival[i])) out[found++] = &byArrival[i];
+        }
+        return found;
+    }
+
+    // Fills `out` with `needed` live players rated in [low, high], walking buckets
+    // outward from `center` so the nearest ratings come first, and skipping ids
+    // already in out[0, taken). Returns false, with out partly written, if there
+    // are not enough.
+    template <typename Live>
+    bool nearest(int center, int low, int high, int needed, Live live, const Player** out, int taken) {
+        int first = bucketOf(low);
+        int last = bucketOf(high);
+        if (countRange(first, last) < needed) return false;
+        int found = 0;
+        int home = bucketOf(center);
+        for (int step = 0; found < needed && (home - step >= first || home + step <= last); step++) {
+            for (int side = 0; side < (step == 0 ? 1 : 2) && found < needed; side++) {
+                int bucket = side == 0 ? home - step : home + step;
+                if (bucket < first || bucket > last) continue;
+                trimFront(bucket, live);
+                for (const Player& player : buckets[bucket]) {
+                    if (player.rating < low || player.rating > high || !live(player)) continue;
+                    bool repeat = false;
+                    for (int i = 0; i < taken + found; i++) repeat = repeat || out[i]->id == player.id;
+                    if (repeat) continue;
+                    out[taken + found++] = &player;
+                    if (found == needed) break;
+                }
+            }
+        }
+        return found == needed;
+    }
+
+    // Drops every entry `keep` rejects and recounts the buckets, in one O(n) pass
+    template <typename KeepBucketed, typename KeepArrival>
+    void retain(KeepBucketed keepBucketed, KeepArrival keepArrival) {
+        std::fill(fenwick.begin(), fenwick.end(), 0);
+        for (int bucket = 0; bucket < bucketCount; bucket++) {
+            auto& entries = buckets[bucket];
+            entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Player& player) {
+                return !keepBucketed(player);
+            }), entries.end());
+            add(bucket, static_cast<int>(entries.size()));
+        }
+        byArrival.erase(std::remove_if(byArrival.begin(), byArrival.end(), [&](const Player& player) {
+            return !keepArrival(player);
+        }), byArrival.end());
+    }
+
+    void clear() {
+        for (auto& bucket : buckets) bucket.clear();
+        std::fill(fenwick.begin(), fenwick.end(), 0);
+        byArrival.clear();
+    }
+};
+
+// A compatible 1/1/3 group found by findSkillGroup: tank, healer, three dps
+struct SkillGroup {
+    const Player* members[PARTY_SIZE];
+    int spread; // highest rating less lowest
+    double window; // half-width of the anchor's window when it matched
+    uint64_t epoch; // skillIndexEpoch when found; the pointers hold while it is unchanged
+};
+
+// One entry of a batch for applyQueueBatch: a join of `player`, or with leave set a
+// leave of player.id from whichever role queue it waits in. source is the client
+// or gateway the join came through, for admission control; ADMISSION_INTERNAL
+// skips the per-source limit.
+struct QueueRequest {
+    Player player;
+    bool leave;
+    int source = -1;
+};
+
+const int ADMISSION_INTERNAL = -1;
+
+enum class QueueResult : uint8_t {
+    Joined,
+    Left,
+    Duplicate, // join of an id already queued or in a party
+    NotQueued, // leave of an id not waiting in any queue, including one already matched
+    RateLimited, // the source is over admission-rate; retry after admissionRetryAfter(source)
+    QueueFull // the queues hold max-queue-size players; back off while queuePressure() is high
+};
 
 struct Instance {
     int id;
     bool active;
     int partiesServed;
     std::chrono::seconds totalTimeServed;
+    int loadedDungeon; // -1 while the instance is cold
+    int coldStarts;
+    int mapLoads;
+    bool recovering; // crashed and not yet back in service
+    int crashes;
+    bool draining; // busy when the fleet shrank; retires once its run ends
+    bool retired; // out of service after a shrink, kept for the summary
+    bool pooled; // held by the manager's selector
 
-    Instance(int instanceId) : id(instanceId), active(false), partiesServed(0),
-        totalTimeServed(std::chrono::seconds(0)) {}
+    Instance(int instanceId = 0) : id(instanceId), active(false), partiesServed(0),
+        totalTimeServed(std::chrono::seconds(0)), loadedDungeon(-1), coldStarts(0), mapLoads(0),
+        recovering(false), crashes(0), draining(false), retired(false), pooled(false) {}
 };
 
-std::vector<Instance> instances;
-std::mutex instancesMutex;
-std::mutex queueMutex;
-std::condition_variable cv;
-std::atomic<bool> shutdown(false);
+// Stable storage for the live fleet: fixed-size chunks allocated as it grows and
+// never moved or freed, so an index or reference held by a runInstance thread
+// stays valid through any resize. Only the queue manager grows it, under
+// instancesMutex; the size is published with release so lock-free readers only
+// ever see fully built instances.
+class InstanceTable {
+public:
+    static const int chunkBits = 8;
+    static const int chunkSize = 1 << chunkBits;
+    static const int maxChunks = 256;
+    static constexpr int capacity = chunkSize * maxChunks;
 
-int tanksAvailable;
-int healersAvailable;
-int dpsAvailable;
+    template <typename Table, typename Value>
+    struct Iterator {
+        Table* table;
+        int index;
+        Value& operator*() const { return (*table)[index]; }
+        Iterator& operator++() {
+            index++;
+            return *this;
+        }
+        bool operator!=(const Iterator& other) const { return index != other.index; }
+    };
 
-int maxInstances; // n
-int minTime; // t1
-int maxTime; // t2
+    InstanceTable() : count(0) {}
 
-void readConfig(int* n, int* t, int* h, int* d, int* t1, int* t2);
-int getRandomClearTime();
-bool canFormParty();
-int maxPossibleParties();
-void formParty();
-int findAvailableInstance();
-void displayStatus();
-void runInstance(int instanceId);
-void queueManager();
-void displaySummary();
+    Instance& operator[](int index) { return chunks[index >> chunkBits][index & (chunkSize - 1)]; }
+    const Instance& operator[](int index) const { return chunks[index >> chunkBits][index & (chunkSize - 1)]; }
+    int size() const { return count.load(std::memory_order_acquire); }
 
+    bool push_back(const Instance& instance) {
+        int index = count.load(std::memory_order_relaxed);
+        if (index >= capacity) return false;
+        std::unique_ptr<Instance[]>& chunk = chunks[index >> chunkBits];
+        if (!chunk) chunk.reset(new Instance[chunkSize]);
+        chunk[index & (chunkSize - 1)] = instance;
+        count.store(index + 1, std::memory_order_release);
+        return true;
+    }
 
-void readConfig(int* n, int* t, int* h, int* d, int* t1, int* t2) {
-    // Open the config file
-    std::ifstream configFile("config.txt");
-    if (!configFile.is_open()) {
-        std::cerr << "Error: Could not open config file!" << std::endl;
-        return;
+    Iterator<InstanceTable, Instance> begin() { return Iterator<InstanceTable, Instance>{ this, 0 }; }
+    Iterator<InstanceTable, Instance> end() { return Iterator<InstanceTable, Instance>{ this, size() }; }
+    Iterator<const InstanceTable, const Instance> begin() const { return Iterator<const InstanceTable, const Instance>{ this, 0 }; }
+    Iterator<const InstanceTable, const Instance> end() const { return Iterator<const InstanceTable, const Instance>{ this, size() }; }
+
+private:
+    std::unique_ptr<Instance[]> chunks[maxChunks];
+    std::atomic<int> count;
+};
+constexpr int InstanceTable::capacity; // std::min takes it by reference; needed before C++17
+
+// What an instance had to do before a party could enter it
+enum class Startup { WarmReuse, MapLoad, ColdStart };
+
+enum class InstancePolicy { LowestIndex, RoundRobin, LeastUtilised, MostRecentlyFreed, PowerOfTwo };
+
+int instanceShards = 8; // shards for power-of-two dispatch; instance i lives in shard i % instanceShards
+
+// Free-instance index shared by the selection policies. The queue manager owns one
+// selector and is the only thread that touches it; runInstance hands finished
+// instances back through freedInstances. Derived classes provide acquireImpl()
+// (returns -1 when nothing is free) and releaseImpl(index, instance).
+template <typename Derived>
+struct InstanceSelector {
+    int acquire() { return static_cast<Derived*>(this)->acquireImpl(); }
+    void release(int index, const Instance& instance) { static_cast<Derived*>(this)->releaseImpl(index, instance); }
+};
+
+// Same choice as the original first-fit scan, O(log n) instead of O(n)
+struct LowestIndexSelector : InstanceSelector<LowestIndexSelector> {
+    std::priority_queue<int, std::vector<int>, std::greater<int>> freeList;
+
+    int acquireImpl() {
+        if (freeList.empty()) return -1;
+        int index = freeList.top();
+        freeList.pop();
+        return index;
     }
+    void releaseImpl(int index, const Instance&) { freeList.push(index); }
+};
 
-    // Read the file line by line
-    std::string line;
-    while (std::getline(configFile, line)) {
-        std::istringstream iss(line);
-        std::string key;
-        iss >> key; // Read the first word
+// First free instance at or after the one following the last dispatch
+struct RoundRobinSelector : InstanceSelector<RoundRobinSelector> {
+    std::set<int> freeList;
+    int cursor = 0;
 
-        if (key == "max-num-instances") {
-            iss >> *n;
-            if (*n <= 0) {
-                std::cerr << "Warning: Invalid value for max-num-instances in config file. Must be > 0." << std::endl;
-                *n = 0; 
+    int acquireImpl() {
+        if (freeList.empty()) return -1;
+        auto it = freeList.lower_bound(cursor);
+        if (it == freeList.end()) it = freeList.begin();
+        int index = *it;
+        freeList.erase(it);
+        cursor = index + 1;
+        return index;
+    }
+    void releaseImpl(int index, const Instance&) { freeList.insert(index); }
+};
+
+// Min-heap on totalTimeServed, ties to the lower index. An instance's time served
+// only changes while it is busy, so keys taken at release never go stale.
+struct LeastUtilisedSelector : InstanceSelector<LeastUtilisedSelector> {
+    typedef std::pair<long long, int> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> freeList;
+
+    int acquireImpl() {
+        if (freeList.empty()) return -1;
+        int index = freeList.top().second;
+        freeList.pop();
+        return index;
+    }
+    void releaseImpl(int index, const Instance& instance) {
+        freeList.push(Entry(instance.totalTimeServed.count(), index));
+    }
+};
+
+// LIFO stack: the instance that just finished is still warm
+struct MostRecentlyFreedSelector : InstanceSelector<MostRecentlyFreedSelector> {
+    std::vector<int> freeList;
+
+    int acquireImpl() {
+        if (freeList.empty()) return -1;
+        int index = freeList.back();
+        freeList.pop_back();
+        return index;
+    }
+    void releaseImpl(int index, const Instance&) { freeList.push_back(index); }
+};
+
+// Power-of-two-choices over instance shards: sample two shards at random and
+// claim from whichever has more free instances, so no dispatch looks at more
+// than two shards yet load stays close to even. If both samples are full it
+// samples again a few times before falling back to the first shard with room.
+// The owner passes its own shard count, so engines in one process can differ.
+struct PowerOfTwoSelector : InstanceSelector<PowerOfTwoSelector> {
+    std::vector<std::vector<int>> shards; // free instances per shard, LIFO
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+    int freeTotal = 0;
+
+    explicit PowerOfTwoSelector(int shardCount) { setShards(shardCount); }
+
+    void setShards(int count) {
+        shards.assign(std::max(1, count), std::vector<int>());
+        freeTotal = 0;
+    }
+
+    int acquireImpl() {
+        if (freeTotal == 0) return -1;
+        int shardCount = static_cast<int>(shards.size());
+        for (int attempt = 0; attempt < 4; attempt++) {
+            int a = static_cast<int>(nextRandom() % shardCount);
+            int b = static_cast<int>(nextRandom() % shardCount);
+            int pick = shards[b].size() > shards[a].size() ? b : a;
+            if (!shards[pick].empty()) return take(pick);
+        }
+        for (int shard = 0; shard < shardCount; shard++) {
+            if (!shards[shard].empty()) return take(shard);
+        }
+        return -1;
+    }
+
+    void releaseImpl(int index, const Instance&) {
+        shards[index % shards.size()].push_back(index);
+        freeTotal++;
+    }
+
+    int take(int shard) {
+        int index = shards[shard].back();
+        shards[shard].pop_back();
+        freeTotal--;
+        return index;
+    }
+
+    uint64_t nextRandom() { // xorshift64
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        return rng;
+    }
+};
+
+// Bench-only stand-in for the original dispatch loop: scan for the first free instance
+struct FirstFitSelector : InstanceSelector<FirstFitSelector> {
+    std::vector<char> isFree;
+
+    int acquireImpl() {
+        for (size_t i = 0; i < isFree.size(); i++) {
+            if (isFree[i]) {
+                isFree[i] = 0;
+                return static_cast<int>(i);
             }
         }
-        else if (key == "num-tank") {
-            iss >> *t;
-            if (*t <= 0) {
-                std::cerr << "Warning: Invalid value for num-tank in config file. Must be > 0." << std::endl;
-                *t = 0; 
+        return -1;
+    }
+    void releaseImpl(int index, const Instance&) {
+        if (index >= static_cast<int>(isFree.size())) isFree.resize(index + 1, 0);
+        isFree[index] = 1;
+    }
+};
+
+// Bench-only: one random shard with room, to show what the second choice buys
+struct RandomShardSelector : InstanceSelector<RandomShardSelector> {
+    PowerOfTwoSelector shards;
+
+    explicit RandomShardSelector(int shardCount) : shards(shardCount) {}
+
+    int acquireImpl() {
+        if (shards.freeTotal == 0) return -1;
+        int shardCount = static_cast<int>(shards.shards.size());
+        for (int attempt = 0; attempt < 8; attempt++) {
+            int shard = static_cast<int>(shards.nextRandom() % shardCount);
+            if (!shards.shards[shard].empty()) return shards.take(shard);
+        }
+        return shards.acquireImpl();
+    }
+    void releaseImpl(int index, const Instance& instance) { shards.releaseImpl(index, instance); }
+};
+
+// Builds a selector for a fleet split into shardCount shards; only the sharded
+// selectors use the count
+template <typename Selector>
+Selector makeSelector(int) { return Selector(); }
+template <>
+PowerOfTwoSelector makeSelector<PowerOfTwoSelector>(int shardCount) { return PowerOfTwoSelector(shardCount); }
+template <>
+RandomShardSelector makeSelector<RandomShardSelector>(int shardCount) { return RandomShardSelector(shardCount); }
+
+// Idle instances that are still spun up, bucketed by the dungeon they have loaded,
+// in front of the policy selector that holds the cold ones. Released instances
+// stay warm while fewer than capacity are warm and idle, otherwise they shut down.
+template <typename Selector>
+struct WarmPool {
+    Selector coldInstances;
+    std::vector<std::vector<int>> warmByDungeon;
+    int warmIdle = 0;
+    int capacity = 0;
+    bool affinity = true; // prefer an instance that already has the party's dungeon loaded
+    double coldStartTime = 0.0;
+    double mapLoadTime = 0.0;
+
+    explicit WarmPool(int shardCount) : coldInstances(makeSelector<Selector>(shardCount)) {}
+
+    void init(int dungeonTypes, int poolSize) {
+        warmByDungeon.assign(dungeonTypes, std::vector<int>());
+        warmIdle = 0;
+        capacity = poolSize;
+    }
+
+    // Pre-initialises the first `capacity` instances and hands every instance to the pool
+    template <typename Fleet>
+    void fill(Fleet& fleet) {
+        for (int i = static_cast<int>(fleet.size()) - 1; i >= 0; i--) {
+            fleet[i].loadedDungeon = i < capacity ? i % static_cast<int>(warmByDungeon.size()) : -1;
+            release(i, fleet[i]);
+        }
+    }
+
+    template <typename Fleet>
+    int acquire(int dungeon, Fleet& fleet, Startup& startup) {
+        int index = -1;
+        if (affinity && !warmByDungeon[dungeon].empty()) {
+            index = warmByDungeon[dungeon].back();
+            warmByDungeon[dungeon].pop_back();
+        }
+        else if (warmIdle > 0) {
+            for (auto& bucket : warmByDungeon) {
+                if (!bucket.empty()) {
+                    index = bucket.back();
+                    bucket.pop_back();
+                    break;
+                }
+            }
+        }
+
+        if (index != -1) {
+            warmIdle--;
+            startup = fleet[index].loadedDungeon == dungeon ? Startup::WarmReuse : Startup::MapLoad;
+        }
+        else {
+            index = coldInstances.acquire();
+            if (index == -1) return -1;
+            startup = Startup::ColdStart;
+        }
+
+        if (startup == Startup::ColdStart) fleet[index].coldStarts++;
+        else if (startup == Startup::MapLoad) fleet[index].mapLoads++;
+        fleet[index].loadedDungeon = dungeon;
+        return index;
+    }
+
+    void release(int index, Instance& instance) {
+        if (instance.loadedDungeon >= 0 && warmIdle < capacity) {
+            warmByDungeon[instance.loadedDungeon].push_back(index);
+            warmIdle++;
+            return;
+        }
+        instance.loadedDungeon = -1;
+        coldInstances.release(index, instance);
+    }
+
+    double startupCost(Startup startup) const {
+        if (startup == Startup::ColdStart) return coldStartTime;
+        if (startup == Startup::MapLoad) return mapLoadTime;
+        return 0.0;
+    }
+};
+
+enum class EventType : uint8_t { Enqueue, Match, Enter, Complete, Leave, Crash };
+const char* const eventTypeNames[] = { "enqueue", "match", "enter", "complete", "leave", "crash" };
+const int eventTypeCount = 6;
+
+// One engine event. subject is the player id for enqueue/leave and the party id
+// otherwise; value is the role, dungeon, startup ms, clear ms or ms before a crash.
+struct EngineEvent {
+    int64_t timeNs; // since engine start
+    EventType type;
+    int32_t subject;
+    int32_t instance; // instance id, 0 when there is none
+    int32_t value;
+};
+
+// Column-chunk event log. The file starts with eventLogMagic and then holds chunks of
+// up to eventChunkSize events:
+//   u32 count, then five columns each as u32 byteLength + bytes:
+//   time (zigzag varint of the delta from the previous event), type (one raw byte per
+//   event), subject and instance (zigzag varint deltas), value (zigzag varint).
+// Deltas restart from zero in every chunk so chunks decode independently.
+const char eventLogMagic[8] = { 'L', 'F', 'G', 'E', 'V', 'T', '0', '1' };
+const size_t eventChunkSize = 65536;
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value);
+uint64_t zigzag(int64_t value);
+int64_t unzigzag(uint64_t value);
+
+// Buffers events from the engine threads and encodes and writes them on its own
+// thread, so recording an event costs one short lock and a push_back.
+struct EventExporter {
+    std::ofstream out;
+    std::mutex bufferMutex;
+    std::condition_variable bufferReady;
+    std::vector<EngineEvent> pending;
+    bool stopping = false;
+    std::thread writer;
+    long long eventsWritten = 0;
+    long long bytesWritten = 0;
+
+    bool open(const std::string& path) {
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return false;
+        out.write(eventLogMagic, sizeof(eventLogMagic));
+        bytesWritten = sizeof(eventLogMagic);
+        pending.reserve(eventChunkSize);
+        writer = std::thread(&EventExporter::writerLoop, this);
+        return true;
+    }
+
+    void record(const EngineEvent& event) {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        pending.push_back(event);
+        if (pending.size() == eventChunkSize) bufferReady.notify_one();
+    }
+
+    // Bulk loads record a whole batch under one lock
+    void recordAll(const std::vector<EngineEvent>& events) {
+        std::lock_guard<std::mutex> lock(bufferMutex);
+        pending.insert(pending.end(), events.begin(), events.end());
+        if (pending.size() >= eventChunkSize) bufferReady.notify_one();
+    }
+
+    // Flushes everything recorded so far and stops the writer
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(bufferMutex);
+            stopping = true;
+        }
+        bufferReady.notify_one();
+        if (writer.joinable()) writer.join();
+        out.close();
+    }
+
+    void writerLoop() {
+        std::vector<EngineEvent> batch;
+        batch.reserve(eventChunkSize);
+        bool done = false;
+        while (!done) {
+            {
+                std::unique_lock<std::mutex> lock(bufferMutex);
+                bufferReady.wait_for(lock, std::chrono::seconds(1), [this]() {
+                    return stopping || pending.size() >= eventChunkSize;
+                });
+                batch.swap(pending);
+                done = stopping;
+            }
+            for (size_t start = 0; start < batch.size(); start += eventChunkSize) {
+                writeChunk(batch.data() + start, std::min(eventChunkSize, batch.size() - start));
+            }
+            batch.clear();
+        }
+        out.flush();
+    }
+
+    void writeChunk(const EngineEvent* events, size_t count) {
+        std::vector<uint8_t> columns[5];
+        int64_t lastTime = 0;
+        int64_t lastSubject = 0;
+        int64_t lastInstance = 0;
+        for (size_t i = 0; i < count; i++) {
+            putVarint(columns[0], zigzag(events[i].timeNs - lastTime));
+            columns[1].push_back(static_cast<uint8_t>(events[i].type));
+            putVarint(columns[2], zigzag(events[i].subject - lastSubject));
+            putVarint(columns[3], zigzag(events[i].instance - lastInstance));
+            putVarint(columns[4], zigzag(events[i].value));
+            lastTime = events[i].timeNs;
+            lastSubject = events[i].subject;
+            lastInstance = events[i].instance;
+        }
+
+        writeU32(static_cast<uint32_t>(count));
+        for (const auto& column : columns) {
+            writeU32(static_cast<uint32_t>(column.size()));
+            out.write(reinterpret_cast<const char*>(column.data()), column.size());
+            bytesWritten += column.size();
+        }
+        eventsWritten += count;
+    }
+
+    void writeU32(uint32_t value) {
+        char bytes[4] = { static_cast<char>(value), static_cast<char>(value >> 8),
+            static_cast<char>(value >> 16), static_cast<char>(value >> 24) };
+        out.write(bytes, 4);
+        bytesWritten += 4;
+    }
+};
+
+enum class DisplayMode {
+    Log,       // a line per party event plus the instance list, written in batches by runLogWriter
+    Dashboard, // fixed-rate terminal dashboard, no per-event output
+    Quiet      // summary only
+};
+
+// Party event lines for display log. Instance threads append under a short lock and
+// never touch std::cout; runLogWriter writes everything pending in one call, then one
+// instance status block if a party entered since the last flush.
+struct LogBuffer {
+    std::mutex mutex;
+    std::string pending;
+    bool statusDue = false;
+
+    void append(const std::string& text, bool entered = false) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending += text;
+        statusDue = statusDue || entered;
+    }
+
+    // Moves the pending text into `out` and returns whether a status block is due
+    bool take(std::string& out) {
+        out.clear();
+        std::lock_guard<std::mutex> lock(mutex);
+        out.swap(pending);
+        bool due = statusDue;
+        statusDue = false;
+        return due;
+    }
+};
+
+int log2Bucket(double seconds);
+double log2BucketUpper(int bucket);
+double bucketPercentile(const uint64_t* counts, double p);
+
+enum InstanceState : uint8_t { INSTANCE_IDLE, INSTANCE_STARTING, INSTANCE_BUSY, INSTANCE_RECOVERING };
+
+// Counters the engine publishes for the dashboard. Engine threads store them with
+// relaxed atomics where they already hold their own locks, and the dashboard thread
+// copies them into a frame without taking any engine lock.
+struct LiveStats {
+    std::unique_ptr<std::atomic<uint8_t>[]> instanceState;
+    std::unique_ptr<std::atomic<uint32_t>[]> instanceRuns;
+    int capacity = 0;
+    std::atomic<int> instanceCount; // grows with the fleet, never past capacity
+    std::atomic<int> roleDepth[ROLE_COUNT];
+    std::atomic<uint64_t> completions;
+    std::atomic<uint64_t> waitBuckets[32]; // bucket b counts queue waits in [2^b, 2^(b+1)) ms
+
+    LiveStats() : instanceCount(0), completions(0) {
+        for (auto& depth : roleDepth) depth.store(0);
+        for (auto& bucket : waitBuckets) bucket.store(0);
+    }
+
+    void init(int maxInstances, int numInstances) {
+        instanceState.reset(new std::atomic<uint8_t>[maxInstances]);
+        instanceRuns.reset(new std::atomic<uint32_t>[maxInstances]);
+        for (int i = 0; i < maxInstances; i++) {
+            instanceState[i].store(INSTANCE_IDLE);
+            instanceRuns[i].store(0);
+        }
+        capacity = maxInstances;
+        instanceCount.store(numInstances);
+    }
+
+    void setState(int index, InstanceState state) {
+        if (index < capacity) instanceState[index].store(state, std::memory_order_relaxed);
+    }
+
+    void recordWait(double seconds) {
+        waitBuckets[log2Bucket(seconds)].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Upper edge of the bucket holding the p-th wait, in seconds
+    double waitPercentile(double p) const {
+        uint64_t counts[32];
+        for (int b = 0; b < 32; b++) counts[b] = waitBuckets[b].load(std::memory_order_relaxed);
+        return bucketPercentile(counts, p);
+    }
+};
+
+// Fixed-memory statistics over the last hour of engine time: one bucket per engine
+// second in a ring, each with a count, sum, max and log2 histogram, so any window up
+// to an hour can be summed on demand and nothing grows with uptime.
+struct RollingWindow {
+    static const int seconds = 3600;
+
+    struct Bucket {
+        long long second = -1;
+        uint32_t count = 0;
+        double sum = 0.0;
+        double max = 0.0;
+        uint32_t histogram[32] = {};
+    };
+
+    struct Summary {
+        uint64_t count = 0;
+        double sum = 0.0;
+        double max = 0.0;
+        double p50 = 0.0;
+        double p99 = 0.0;
+    };
+
+    std::vector<Bucket> buckets;
+
+    RollingWindow() : buckets(seconds) {}
+
+    void add(long long second, double value) {
+        Bucket& bucket = buckets[second % seconds];
+        if (bucket.second != second) bucket = Bucket();
+        bucket.second = second;
+        bucket.count++;
+        bucket.sum += value;
+        bucket.max = std::max(bucket.max, value);
+        bucket.histogram[log2Bucket(value)]++;
+    }
+
+    Summary summarize(long long now, int window) const {
+        Summary summary;
+        uint64_t histogram[32] = {};
+        for (const auto& bucket : buckets) {
+            if (bucket.second < 0 || bucket.second > now || bucket.second <= now - window) continue;
+            summary.count += bucket.count;
+            summary.sum += bucket.sum;
+            summary.max = std::max(summary.max, bucket.max);
+            for (int b = 0; b < 32; b++) histogram[b] += bucket.histogram[b];
+        }
+        // Histogram percentiles are bucket upper edges, so never report past the true max
+        summary.p50 = std::min(histogramPercentile(histogram, summary.count, 0.5), summary.max);
+        summary.p99 = std::min(histogramPercentile(histogram, summary.count, 0.99), summary.max);
+        return summary;
+    }
+
+    static double histogramPercentile(const uint64_t* histogram, uint64_t total, double p) {
+        if (total == 0) return 0.0;
+        uint64_t rank = static_cast<uint64_t>(p * (total - 1)) + 1;
+        uint64_t seen = 0;
+        for (int b = 0; b < 32; b++) {
+            seen += histogram[b];
+            if (seen >= rank) return log2BucketUpper(b);
+        }
+        return log2BucketUpper(31);
+    }
+};
+
+// Daemon-mode replacements for the unbounded per-run vectors, guarded by rollingMutex
+struct RollingStats {
+    RollingWindow queueWait; // per matched player
+    RollingWindow completions; // value is the clear time
+    RollingWindow startup;
+    RollingWindow crashes; // value is the work lost
+    RollingWindow recovery; // crash to re-entry per requeued party
+};
+
+// Joins, parties and waits per engine hour for the whole run, so a bad hour is not
+// averaged away. Guarded by rollingMutex.
+struct HourlyReport {
+    struct Hour {
+        uint64_t joins[ROLE_COUNT] = {};
+        uint64_t parties = 0;
+        uint64_t waits = 0;
+        double waitSum = 0.0;
+        double waitMax = 0.0;
+        uint64_t histogram[32] = {};
+        double minutes = 60.0; // of the hour the run covered; less for the last one
+    };
+
+    std::vector<Hour> hours;
+
+    // Trims each hour's minutes to a run that ended at endSecond
+    void finish(double endSecond) {
+        for (size_t h = 0; h < hours.size(); h++) {
+            hours[h].minutes = std::max(0.0, std::min(60.0, (endSecond - 3600.0 * h) / 60.0));
+        }
+    }
+
+    Hour& at(long long second) {
+        size_t hour = static_cast<size_t>(std::max(0LL, second) / 3600);
+        if (hour >= hours.size()) hours.resize(hour + 1);
+        return hours[hour];
+    }
+
+    void join(long long second, Role role) { at(second).joins[role]++; }
+    void party(long long second) { at(second).parties++; }
+
+    void wait(long long second, double seconds) {
+        Hour& hour = at(second);
+        hour.waits++;
+        hour.waitSum += seconds;
+        hour.waitMax = std::max(hour.waitMax, seconds);
+        hour.histogram[log2Bucket(seconds)]++;
+    }
+};
+
+// One row of a player join file
+struct JoinRecord {
+    uint32_t id;
+    uint8_t roleFlags;
+    uint8_t bracket;
+    int64_t timestamp; // seconds; the newest record is treated as joining now
+};
+
+// Binary join files: joinFileMagic, u64 record count, then 16-byte little-endian
+// records of u32 id, u8 role flags, u8 bracket, u16 reserved, i64 timestamp.
+const char joinFileMagic[8] = { 'L', 'F', 'G', 'J', 'O', 'I', 'N', '1' };
+const size_t joinRecordSize = 16;
+
+// Read-only memory map of a whole file
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+
+    bool open(const std::string& path) {
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize)) return false;
+        size = static_cast<size_t>(fileSize.QuadPart);
+        if (size == 0) return true;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) return false;
+        data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        return data != nullptr;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size = static_cast<size_t>(info.st_size);
+        if (size == 0) {
+            ::close(fd);
+            return true;
+        }
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapped);
+        return true;
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data != nullptr) UnmapViewOfFile(data);
+        if (mapping != nullptr) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+        if (data != nullptr) munmap(const_cast<char*>(data), size);
+#endif
+    }
+};
+
+inline void cpuRelax() {
+#ifdef LFG_HAVE_SSE2
+    _mm_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+// Lock for short critical sections: a bounded spin with pause and exponential
+// backoff, then parking in the kernel (futex on Linux, WaitOnAddress on Windows).
+// state is 0 unlocked, 1 locked, 2 locked with parked waiters, so unlock only
+// makes a syscall when someone is actually parked. The spin budget adapts like
+// glibc's adaptive mutex, tracking how long acquisitions recently took to spin,
+// and is zero on a single CPU where spinning can only delay the holder.
+class HybridMutex {
+public:
+    HybridMutex() : state(0), spinEstimate(0) {}
+    HybridMutex(const HybridMutex&) = delete;
+    HybridMutex& operator=(const HybridMutex&) = delete;
+
+    void lock() {
+        int expected = 0;
+        if (state.compare_exchange_strong(expected, 1, std::memory_order_acquire)) return;
+
+        int limit = std::min(maxSpin, spinEstimate.load(std::memory_order_relaxed) * 2 + 16);
+        if (!multiCore()) limit = 0;
+        int spun = 0;
+        for (int backoff = 1; spun < limit; backoff = std::min(backoff * 2, 64)) {
+            for (int i = 0; i < backoff; i++) cpuRelax();
+            spun += backoff;
+            expected = 0;
+            if (state.load(std::memory_order_relaxed) == 0 &&
+                state.compare_exchange_weak(expected, 1, std::memory_order_acquire)) {
+                int estimate = spinEstimate.load(std::memory_order_relaxed);
+                spinEstimate.store(estimate + (spun - estimate) / 8, std::memory_order_relaxed);
+                return;
+            }
+        }
+        if (limit > 0) {
+            int estimate = spinEstimate.load(std::memory_order_relaxed);
+            spinEstimate.store(estimate + (limit - estimate) / 8, std::memory_order_relaxed);
+        }
+
+        int current = state.exchange(2, std::memory_order_acquire);
+        while (current != 0) {
+            park();
+            current = state.exchange(2, std::memory_order_acquire);
+        }
+    }
+
+    bool try_lock() {
+        int expected = 0;
+        return state.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+    }
+
+    void unlock() {
+        if (state.exchange(0, std::memory_order_release) == 2) wake();
+    }
+
+private:
+    static constexpr int maxSpin = 4000;
+    std::atomic<int> state;
+    std::atomic<int> spinEstimate;
+
+    static bool multiCore() {
+        static const bool result = std::thread::hardware_concurrency() > 1;
+        return result;
+    }
+
+    void park() {
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<int*>(&state), FUTEX_WAIT_PRIVATE, 2, nullptr, nullptr, 0);
+#elif defined(_WIN32)
+        int parked = 2;
+        WaitOnAddress(&state, &parked, sizeof(parked), INFINITE);
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    void wake() {
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<int*>(&state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#elif defined(_WIN32)
+        WakeByAddressSingle(&state);
+#endif
+    }
+};
+constexpr int HybridMutex::maxSpin; // std::min takes it by reference; needed before C++17
+
+// Build with LFG_STD_QUEUE_MUTEX to put std::mutex back on the role queues
+#ifdef LFG_STD_QUEUE_MUTEX
+typedef std::mutex QueueMutex;
+#else
+typedef HybridMutex QueueMutex;
+#endif
+
+// Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3"):
+// a keyed bijection on 128-bit counters. Any draw is computed straight from its
+// counter, so results do not depend on how many threads there are or which one
+// asks first.
+struct Philox4x32 {
+    uint32_t v[4];
+
+    Philox4x32(uint64_t key, uint32_t c0, uint32_t c1, uint32_t c2, uint32_t c3) {
+        uint32_t k0 = static_cast<uint32_t>(key);
+        uint32_t k1 = static_cast<uint32_t>(key >> 32);
+        v[0] = c0;
+        v[1] = c1;
+        v[2] = c2;
+        v[3] = c3;
+        for (int round = 0; round < 10; round++) {
+            if (round > 0) {
+                k0 += 0x9E3779B9u;
+                k1 += 0xBB67AE85u;
+            }
+            uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * v[0];
+            uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * v[2];
+            uint32_t next[4] = { static_cast<uint32_t>(p1 >> 32) ^ v[1] ^ k0, static_cast<uint32_t>(p1),
+                static_cast<uint32_t>(p0 >> 32) ^ v[3] ^ k1, static_cast<uint32_t>(p0) };
+            std::copy(next, next + 4, v);
+        }
+    }
+
+    double uniform(int word) const { return v[word] * (1.0 / 4294967296.0); } // [0, 1)
+    int below(int word, int range) const { return static_cast<int>((static_cast<uint64_t>(v[word]) * range) >> 32); }
+};
+
+// Last counter word, so each kind of draw for a run has its own stream
+enum RngStream : uint32_t { RNG_CLEAR_TIME = 0, RNG_CRASH = 1, RNG_DUNGEON = 2, RNG_ARRIVAL = 3, RNG_RATING = 4 };
+
+enum class ClearTimeDistribution { Uniform, LogNormal };
+
+// Batch sampler for clear times: eight xoshiro256+ lanes, with draw k taken from
+// lane k % 8. fill() steps two lanes per SSE2 register and next() one lane at a
+// time. Both paths run the same IEEE operations in the same order (the log, cos
+// and exp below are plain polynomials rather than libm calls), so a seed gives
+// the same doubles bit for bit either way. That needs multiply-adds left unfused,
+// which -march=native would otherwise do to either path, so contraction is off
+// for the whole sampler.
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#pragma fp_contract(off)
+#endif
+struct ClearTimeSampler {
+    static const int lanes = 8;
+    uint64_t s[4][lanes]; // word-major so one word of two neighbouring lanes loads as a register
+    uint64_t drawn = 0;
+    ClearTimeDistribution distribution;
+    double low;
+    double high;
+    double mu; // log of the median for lognormal
+    double sigma;
+
+    ClearTimeSampler(uint64_t seed, ClearTimeDistribution dist, double minSeconds, double maxSeconds, double logSigma)
+        : distribution(dist), low(minSeconds), high(maxSeconds), mu(0.5 * (polyLog(minSeconds) + polyLog(maxSeconds))),
+        sigma(logSigma) {
+        for (int lane = 0; lane < lanes; lane++) {
+            for (int word = 0; word < 4; word++) {
+                seed += 0x9E3779B97F4A7C15ULL; // splitmix64
+                uint64_t z = seed;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                s[word][lane] = z ^ (z >> 31);
+            }
+        }
+    }
+
+    uint64_t nextBits(int lane) {
+        uint64_t result = s[0][lane] + s[3][lane];
+        uint64_t t = s[1][lane] << 17;
+        s[2][lane] ^= s[0][lane];
+        s[3][lane] ^= s[1][lane];
+        s[1][lane] ^= s[2][lane];
+        s[0][lane] ^= s[3][lane];
+        s[2][lane] ^= t;
+        s[3][lane] = (s[3][lane] << 45) | (s[3][lane] >> 19);
+        return result;
+    }
+
+    double next() {
+        int lane = static_cast<int>(drawn++ % lanes);
+        double u1 = unit(nextBits(lane));
+        if (distribution == ClearTimeDistribution::Uniform) return low + (high - low) * u1;
+        double u2 = unit(nextBits(lane));
+        return logNormal(u1, u2, low, high, mu, sigma);
+    }
+
+    void fill(double* out, size_t count) {
+        size_t i = 0;
+        while (i < count && drawn % lanes != 0) out[i++] = next();
+#ifdef LFG_HAVE_SSE2
+        for (; i + lanes <= count; i += lanes) {
+            for (int pair = 0; pair < lanes; pair += 2) {
+                __m128i w0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&s[0][pair]));
+                __m128i w1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&s[1][pair]));
+                __m128i w2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&s[2][pair]));
+                __m128i w3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&s[3][pair]));
+                __m128d u1 = unit2(step2(w0, w1, w2, w3));
+                __m128d value;
+                if (distribution == ClearTimeDistribution::Uniform) {
+                    value = _mm_add_pd(_mm_set1_pd(low), _mm_mul_pd(_mm_set1_pd(high - low), u1));
+                }
+                else {
+                    __m128d u2 = unit2(step2(w0, w1, w2, w3));
+                    value = logNormal2(u1, u2);
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&s[0][pair]), w0);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&s[1][pair]), w1);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&s[2][pair]), w2);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(&s[3][pair]), w3);
+                _mm_storeu_pd(out + i + pair, value);
+            }
+            drawn += lanes;
+        }
+#endif
+        for (; i < count; i++) out[i] = next();
+    }
+
+    // Box-Muller normal from two uniforms, exponentiated and clamped to [low, high]
+    static double logNormal(double u1, double u2, double low, double high, double mu, double sigma) {
+        double z = std::sqrt(-2.0 * polyLog(1.0 - u1)) * polyCos2Pi(u2);
+        return std::max(low, std::min(high, polyExp(mu + sigma * z)));
+    }
+
+    static double bitsToDouble(uint64_t bits) {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    static uint64_t doubleToBits(double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    // Top 52 bits as the mantissa of a double in [1, 2), minus one: exact in [0, 1)
+    static double unit(uint64_t bits) {
+        return bitsToDouble((bits >> 12) | 0x3FF0000000000000ULL) - 1.0;
+    }
+
+    // Natural log of a positive normal double: x = m * 2^e with m in [sqrt(1/2), sqrt(2)),
+    // then log m = 2 atanh((m - 1) / (m + 1)) as an odd series
+    static double polyLog(double x) {
+        uint64_t bits = doubleToBits(x);
+        double e = bitsToDouble(((bits >> 52) & 0x7FF) | 0x4330000000000000ULL) - 4503599627370496.0 - 1023.0;
+        double m = bitsToDouble((bits & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL);
+        if (m > 1.4142135623730951) {
+            m = m * 0.5;
+            e = e + 1.0;
+        }
+        double t = (m - 1.0) / (m + 1.0);
+        double t2 = t * t;
+        double series = 1.0 / 3 + t2 * (1.0 / 5 + t2 * (1.0 / 7 + t2 * (1.0 / 9 + t2 * (1.0 / 11 + t2 * (1.0 / 13 + t2 * (1.0 / 15))))));
+        return e * 0.6931471805599453 + 2.0 * (t + t * t2 * series);
+    }
+
+    // Round to nearest even by pushing the fraction out of the mantissa; plain
+    // adds, so both paths agree without depending on libm or MXCSR conversions
+    static double roundEven(double x) {
+        return (x + 6755399441055744.0) - 6755399441055744.0;
+    }
+
+    // cos(2 pi u) for u in [0, 1): reduce to a quarter turn, then a sin or cos series
+    static double polyCos2Pi(double u) {
+        int quadrant = static_cast<int>(roundEven(u * 4.0));
+        double a = (u - quadrant * 0.25) * 6.283185307179586;
+        double a2 = a * a;
+        double c = 1.0 + a2 * (-1.0 / 2 + a2 * (1.0 / 24 + a2 * (-1.0 / 720 + a2 * (1.0 / 40320 +
+            a2 * (-1.0 / 3628800 + a2 * (1.0 / 479001600))))));
+        double sn = a * (1.0 + a2 * (-1.0 / 6 + a2 * (1.0 / 120 + a2 * (-1.0 / 5040 + a2 * (1.0 / 362880 +
+            a2 * (-1.0 / 39916800))))));
+        double value = (quadrant & 1) ? sn : c;
+        return ((quadrant + 1) & 2) ? -value : value;
+    }
+
+    // e^y as 2^n * e^r with |r| <= ln(2) / 2
+    static double polyExp(double y) {
+        int n = static_cast<int>(roundEven(y * 1.4426950408889634));
+        double r = (y - n * 0.6931471803691238) - n * 1.9082149292705877e-10;
+        double p = 1.0 + r * (1.0 + r * (1.0 / 2 + r * (1.0 / 6 + r * (1.0 / 24 + r * (1.0 / 120 + r * (1.0 / 720 +
+            r * (1.0 / 5040 + r * (1.0 / 40320 + r * (1.0 / 362880 + r * (1.0 / 3628800 + r * (1.0 / 39916800)))))))))));
+        return p * bitsToDouble(static_cast<uint64_t>(n + 1023) << 52);
+    }
+
+#ifdef LFG_HAVE_SSE2
+    static __m128i step2(__m128i& w0, __m128i& w1, __m128i& w2, __m128i& w3) {
+        __m128i result = _mm_add_epi64(w0, w3);
+        __m128i t = _mm_slli_epi64(w1, 17);
+        w2 = _mm_xor_si128(w2, w0);
+        w3 = _mm_xor_si128(w3, w1);
+        w1 = _mm_xor_si128(w1, w2);
+        w0 = _mm_xor_si128(w0, w3);
+        w2 = _mm_xor_si128(w2, t);
+        w3 = _mm_or_si128(_mm_slli_epi64(w3, 45), _mm_srli_epi64(w3, 19));
+        return result;
+    }
+
+    static __m128d roundEven2(__m128d x) {
+        __m128d magic = _mm_set1_pd(6755399441055744.0);
+        return _mm_sub_pd(_mm_add_pd(x, magic), magic);
+    }
+
+    static __m128d unit2(__m128i bits) {
+        __m128i mantissa = _mm_or_si128(_mm_srli_epi64(bits, 12), _mm_set1_epi64x(0x3FF0000000000000LL));
+        return _mm_sub_pd(_mm_castsi128_pd(mantissa), _mm_set1_pd(1.0));
+    }
+
+    // Lane mask from the low 32 bits of each 64-bit lane being nonzero after masking with bit
+    static __m128d laneFlag(__m128i quadrants64, int bit) {
+        __m128i masked = _mm_and_si128(quadrants64, _mm_set1_epi32(bit));
+        return _mm_castsi128_pd(_mm_xor_si128(_mm_cmpeq_epi32(masked, _mm_setzero_si128()), _mm_set1_epi32(-1)));
+    }
+
+    static __m128d select(__m128d mask, __m128d ifSet, __m128d ifClear) {
+        return _mm_or_pd(_mm_and_pd(mask, ifSet), _mm_andnot_pd(mask, ifClear));
+    }
+
+    static __m128d polyLog2(__m128d x) {
+        __m128i bits = _mm_castpd_si128(x);
+        __m128i exponent = _mm_and_si128(_mm_srli_epi64(bits, 52), _mm_set1_epi64x(0x7FF));
+        __m128d e = _mm_sub_pd(_mm_sub_pd(_mm_castsi128_pd(_mm_or_si128(exponent, _mm_set1_epi64x(0x4330000000000000LL))),
+            _mm_set1_pd(4503599627370496.0)), _mm_set1_pd(1023.0));
+        __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+            _mm_set1_epi64x(0x3FF0000000000000LL)));
+        __m128d high = _mm_cmpgt_pd(m, _mm_set1_pd(1.4142135623730951));
+        m = select(high, _mm_mul_pd(m, _mm_set1_pd(0.5)), m);
+        e = select(high, _mm_add_pd(e, _mm_set1_pd(1.0)), e);
+        __m128d one = _mm_set1_pd(1.0);
+        __m128d t = _mm_div_pd(_mm_sub_pd(m, one), _mm_add_pd(m, one));
+        __m128d t2 = _mm_mul_pd(t, t);
+        __m128d series = _mm_set1_pd(1.0 / 15);
+        const double coefficients[] = { 1.0 / 13, 1.0 / 11, 1.0 / 9, 1.0 / 7, 1.0 / 5, 1.0 / 3 };
+        for (double coefficient : coefficients) series = _mm_add_pd(_mm_set1_pd(coefficient), _mm_mul_pd(t2, series));
+        __m128d odd = _mm_add_pd(t, _mm_mul_pd(_mm_mul_pd(t, t2), series));
+        return _mm_add_pd(_mm_mul_pd(e, _mm_set1_pd(0.6931471805599453)), _mm_mul_pd(_mm_set1_pd(2.0), odd));
+    }
+
+    static __m128d polyCos2Pi2(__m128d u) {
+        __m128d q = roundEven2(_mm_mul_pd(u, _mm_set1_pd(4.0)));
+        __m128i quadrant = _mm_cvttpd_epi32(q);
+        __m128d a = _mm_mul_pd(_mm_sub_pd(u, _mm_mul_pd(q, _mm_set1_pd(0.25))), _mm_set1_pd(6.283185307179586));
+        __m128d a2 = _mm_mul_pd(a, a);
+        __m128d c = _mm_set1_pd(1.0 / 479001600);
+        const double cosCoefficients[] = { -1.0 / 3628800, 1.0 / 40320, -1.0 / 720, 1.0 / 24, -1.0 / 2, 1.0 };
+        for (double coefficient : cosCoefficients) c = _mm_add_pd(_mm_set1_pd(coefficient), _mm_mul_pd(a2, c));
+        __m128d sn = _mm_set1_pd(-1.0 / 39916800);
+        const double sinCoefficients[] = { 1.0 / 362880, -1.0 / 5040, 1.0 / 120, -1.0 / 6, 1.0 };
+        for (double coefficient : sinCoefficients) sn = _mm_add_pd(_mm_set1_pd(coefficient), _mm_mul_pd(a2, sn));
+        sn = _mm_mul_pd(a, sn);
+        __m128i quadrants64 = _mm_unpacklo_epi32(quadrant, quadrant);
+        __m128d value = select(laneFlag(quadrants64, 1), sn, c);
+        __m128i shifted = _mm_add_epi32(quadrants64, _mm_set1_epi32(1));
+        return select(laneFlag(shifted, 2), _mm_xor_pd(value, _mm_set1_pd(-0.0)), value);
+    }
+
+    static __m128d polyExp2(__m128d y) {
+        __m128d nd = roundEven2(_mm_mul_pd(y, _mm_set1_pd(1.4426950408889634)));
+        __m128i n = _mm_cvttpd_epi32(nd);
+        __m128d r = _mm_sub_pd(_mm_sub_pd(y, _mm_mul_pd(nd, _mm_set1_pd(0.6931471803691238))),
+            _mm_mul_pd(nd, _mm_set1_pd(1.9082149292705877e-10)));
+        __m128d p = _mm_set1_pd(1.0 / 39916800);
+        const double coefficients[] = { 1.0 / 3628800, 1.0 / 362880, 1.0 / 40320, 1.0 / 5040, 1.0 / 720, 1.0 / 120,
+            1.0 / 24, 1.0 / 6, 1.0 / 2, 1.0, 1.0 };
+        for (double coefficient : coefficients) p = _mm_add_pd(_mm_set1_pd(coefficient), _mm_mul_pd(r, p));
+        __m128i biased = _mm_unpacklo_epi32(_mm_add_epi32(n, _mm_set1_epi32(1023)), _mm_setzero_si128());
+        return _mm_mul_pd(p, _mm_castsi128_pd(_mm_slli_epi64(biased, 52)));
+    }
+
+    __m128d logNormal2(__m128d u1, __m128d u2) const {
+        __m128d logU = polyLog2(_mm_sub_pd(_mm_set1_pd(1.0), u1));
+        __m128d z = _mm_mul_pd(_mm_sqrt_pd(_mm_mul_pd(_mm_set1_pd(-2.0), logU)), polyCos2Pi2(u2));
+        __m128d x = polyExp2(_mm_add_pd(_mm_set1_pd(mu), _mm_mul_pd(_mm_set1_pd(sigma), z)));
+        return _mm_max_pd(_mm_set1_pd(low), _mm_min_pd(_mm_set1_pd(high), x));
+    }
+#endif
+};
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT ON
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#elif defined(_MSC_VER)
+#pragma fp_contract(on)
+#endif
+
+// Where daemon-mode joins come from: a constant arrival-rate, a 24-hour curve
+// around it, or a per-minute histogram of a real day
+enum class ArrivalModel { Steady, Diurnal, Trace };
+
+// Workload scenarios: back-to-back phases, each with a linear ramp of joins per
+// minute and a role mix, plus fleet-size changes and failures at fixed offsets.
+// Text form, one directive per line (durations like 90s, 30m, 1h30m):
+//   phase ramp 30m arrivals 0 5000 mix 1 1 3
+//   phase hold 2h arrivals 5000 mix 1 1 5
+//   phase drain 20m arrivals 0
+//   at 45m fleet 3000
+//   at 1h10m fail 50 for 5m
+// A phase without arrivals or mix carries on from the one before it. Failed
+// instances leave service for the given time (if omitted, the recovery-time in
+// effect when the scenario runs); busy ones finish their run first.
+struct ScenarioPhase {
+    char name[16];
+    int64_t startMs;
+    int64_t endMs;
+    double rateFrom; // joins per minute when the phase starts
+    double rateTo; // and when it ends
+    double mix[ROLE_COUNT];
+};
+
+enum ScenarioActionKind : uint32_t { SCENARIO_FLEET = 0, SCENARIO_FAIL = 1, SCENARIO_RESTORE = 2 }; // restore marks the end of a failure
+
+struct ScenarioAction {
+    int64_t atMs;
+    uint32_t kind;
+    int32_t count; // new fleet size, or instances failed
+    int64_t durationMs; // how long failed instances stay out, or -1 for recovery-time when run
+};
+
+// Binary form: magic, u32 phase count, u32 action count, then fixed-size little-endian records
+const char scenarioMagic[8] = { 'L', 'F', 'G', 'S', 'C', 'N', '0', '1' };
+const size_t scenarioPhaseSize = 16 + 8 * 2 + 8 * 2 + 8 * ROLE_COUNT;
+const size_t scenarioActionSize = 8 + 4 + 4 + 8;
+
+struct Scenario {
+    std::vector<ScenarioPhase> phases;
+    std::vector<ScenarioAction> actions; // by time
+    bool repeats = false; // phases loop forever, as the 24 h diurnal curve does
+
+    int64_t lengthMs() const { return phases.empty() ? 0 : phases.back().endMs; }
+
+    // Offset into the phases for engine time ms
+    int64_t wrap(int64_t ms) const { return repeats && lengthMs() > 0 ? ms % lengthMs() : ms; }
+
+    // Phase running at ms, or nullptr once the scenario is over
+    const ScenarioPhase* phaseAt(int64_t ms) const {
+        ms = wrap(ms);
+        auto after = std::upper_bound(phases.begin(), phases.end(), ms,
+            [](int64_t t, const ScenarioPhase& phase) { return t < phase.endMs; });
+        return after == phases.end() ? nullptr : &*after;
+    }
+
+    double rateAt(int64_t ms) const {
+        ms = wrap(ms);
+        const ScenarioPhase* phase = phaseAt(ms);
+        if (!phase) return 0.0;
+        double progress = phase->endMs > phase->startMs ? static_cast<double>(ms - phase->startMs) / (phase->endMs - phase->startMs) : 0.0;
+        return phase->rateFrom + (phase->rateTo - phase->rateFrom) * progress;
+    }
+
+    // Actions with each failure's end added as a restore, by time. Failures
+    // without their own duration stay out for recoveryMs.
+    std::vector<ScenarioAction> timeline(int64_t recoveryMs) const {
+        std::vector<ScenarioAction> steps(actions);
+        for (const auto& action : actions) {
+            if (action.kind != SCENARIO_FAIL) continue;
+            ScenarioAction restore = action;
+            restore.durationMs = action.durationMs >= 0 ? action.durationMs : recoveryMs;
+            restore.atMs = action.atMs + restore.durationMs;
+            restore.kind = SCENARIO_RESTORE;
+            steps.push_back(restore);
+        }
+        std::stable_sort(steps.begin(), steps.end(), [](const ScenarioAction& a, const ScenarioAction& b) { return a.atMs < b.atMs; });
+        return steps;
+    }
+
+    double peakRate() const {
+        double peak = 0.0;
+        for (const auto& phase : phases) peak = std::max(peak, std::max(phase.rateFrom, phase.rateTo));
+        return peak;
+    }
+};
+
+// Region-scale what-if simulation. The fleet is split into shards, each a logical
+// process that owns a slice of the instances and its own role queues. Players
+// arrive at a shard; when a party finishes, some of its players queue again at a
+// shard picked from the party's hash, which is the only traffic between shards.
+// Every random draw is a hash of (shard, counter), so a shard's history depends
+// only on the order of its own events, never on which thread ran them.
+// Scenario steps (fleet changes, failures) and kicks, which retry matching after
+// a step freed several instances at once, only ever target their own shard.
+enum SimEventType : uint8_t { SIM_COMPLETE = 0, SIM_REJOIN = 1, SIM_ARRIVAL = 2, SIM_SCENARIO = 3, SIM_KICK = 4 };
+
+struct SimEvent {
+    int64_t time; // simulated ms
+    uint8_t type;
+    int32_t source; // shard that scheduled it
+    int32_t dest;
+    uint64_t seq; // the source's party or arrival counter, unique per (type, source)
+
+    // Order of events within a shard. Every backend uses it, so ties break identically.
+    bool operator<(const SimEvent& other) const {
+        if (time != other.time) return time < other.time;
+        if (type != other.type) return type < other.type;
+        if (source != other.source) return source < other.source;
+        return seq < other.seq;
+    }
+    bool operator>(const SimEvent& other) const { return other < *this; }
+};
+
+// An event schedules at most four more: the next arrival or scenario step, and one
+// party's completion, rejoin and follow-up kick
+struct SimOutput {
+    SimEvent events[4];
+    int count = 0;
+    void push(const SimEvent& event) { events[count++] = event; }
+};
+
+// A shard's totals for the simulated hour in progress, kept small because it is
+// part of the state saved before every optimistic event
+struct SimHour {
+    uint32_t joins[ROLE_COUNT];
+    uint32_t completions;
+    uint32_t waits;
+    int64_t waitSumMs;
+    int64_t waitMaxMs;
+    uint32_t histogram[32]; // log2 ms buckets, as HourlyReport
+};
+
+// Fixed-size part of a shard's state, copied whole before each optimistic event
+struct SimScalars {
+    int freeInstances; // negative while failures or a shrink still wait on busy instances
+    int capacity; // the shard's share of the fleet
+    int64_t head[ROLE_COUNT]; // absolute queue positions
+    int64_t tail[ROLE_COUNT];
+    uint64_t partySeq;
+    uint64_t arrivalSeq;
+    int64_t events;
+    int64_t arrivals;
+    int64_t rejoins;
+    int64_t parties;
+    int64_t completions;
+    int64_t waitSumMs;
+    int64_t waitMaxMs;
+    SimHour hour; // totals for simulated hour hourIndex
+    int64_t hourIndex;
+};
+
+struct SimShard {
+    int id = 0;
+    double arrivalMeanMs = 1000.0;
+    SimScalars sc = {};
+    std::vector<int64_t> queue[ROLE_COUNT]; // join times, append-only so undo is a truncation
+    int64_t base[ROLE_COUNT] = {}; // absolute position of queue[r][0]
+    // Clear times for one block of party numbers. Derived from (shard, block) alone,
+    // so it is a cache rather than state and rollbacks may refill it freely.
+    std::vector<int64_t> clearTimes;
+    uint64_t clearBlock = UINT64_MAX;
+    std::vector<SimHour> hours; // closed hours, one per index below sc.hourIndex
+
+    int64_t depth(int role) const { return sc.tail[role] - sc.head[role]; }
+
+    void push(int role, int64_t joined) {
+        queue[role].push_back(joined);
+        sc.tail[role]++;
+        sc.hour.joins[role]++;
+    }
+
+    // Closes every hour before the one holding ms
+    void advanceHour(int64_t ms) {
+        while (sc.hourIndex < ms / 3600000) {
+            hours.push_back(sc.hour);
+            sc.hour = SimHour();
+            sc.hourIndex++;
+        }
+    }
+
+    int64_t pop(int role) {
+        return queue[role][static_cast<size_t>(sc.head[role]++ - base[role])];
+    }
+
+    void restore(const SimScalars& saved) {
+        sc = saved;
+        hours.resize(static_cast<size_t>(sc.hourIndex));
+        for (int role = 0; role < ROLE_COUNT; role++) {
+            queue[role].resize(static_cast<size_t>(sc.tail[role] - base[role]));
+        }
+    }
+
+    // Drops entries before keepFrom once they are the bulk of a queue
+    void compact(const int64_t* keepFrom) {
+        for (int role = 0; role < ROLE_COUNT; role++) {
+            size_t drop = static_cast<size_t>(keepFrom[role] - base[role]);
+            if (drop < 4096 || drop * 2 < queue[role].size()) continue;
+            queue[role].erase(queue[role].begin(), queue[role].begin() + drop);
+            base[role] += drop;
+        }
+    }
+};
+
+struct SimParams {
+    int shards;
+    int instances;
+    int64_t minMs; // t1
+    int64_t maxMs; // t2
+    int64_t endMs;
+    int replayPercent; // chance a finished party's players queue again
+    ClearTimeDistribution distribution;
+    double sigma; // lognormal shape
+    const Scenario* scenario; // drives arrivals and the fleet when set
+    std::vector<ScenarioAction> scenarioSteps;
+    double scenarioPeak; // joins per minute, the thinning bound
+};
+
+const uint64_t simClearBlock = 1024; // parties per batch of sampled clear times
+
+struct SimResult {
+    std::vector<HourlyReport::Hour> hours; // by simulated hour, not part of the outcome
+    int64_t events = 0;
+    int64_t arrivals = 0;
+    int64_t rejoins = 0;
+    int64_t parties = 0;
+    int64_t completions = 0;
+    int64_t waitSumMs = 0;
+    int64_t waitMaxMs = 0;
+    uint64_t checksum = 0;
+    long long rolledBack = 0; // work undone, not part of the outcome
+    long long syncRounds = 0;
+
+    bool sameOutcome(const SimResult& other) const {
+        return events == other.events && arrivals == other.arrivals && rejoins == other.rejoins &&
+            parties == other.parties && completions == other.completions && waitSumMs == other.waitSumMs &&
+            waitMaxMs == other.waitMaxMs && checksum == other.checksum;
+    }
+};
+
+// Reusable barrier for the parallel backends; wait() is true for the last thread to arrive
+class SimBarrier {
+public:
+    explicit SimBarrier(int count) : threshold(count), waiting(0), generation(0) {}
+
+    bool wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        unsigned long long phase = generation;
+        if (++waiting == threshold) {
+            waiting = 0;
+            generation++;
+            cv.notify_all();
+            return true;
+        }
+        cv.wait(lock, [&]() { return generation != phase; });
+        return false;
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    int threshold;
+    int waiting;
+    unsigned long long generation;
+};
+
+// Shadow mode runs several matchmaking configurations against one recorded
+// arrival stream, each in its own engine on a virtual clock, so a comparison is
+// not drowned out by each run having different joins and clear times.
+struct ShadowVariant {
+    std::string label;
+    FairnessPolicy fairness;
+    double agingRate;
+    InstancePolicy instancePolicy;
+    int instances;
+    int warmPoolSize;
+    double matchInterval; // seconds between batch matching passes; 0 matches on every event
+};
+
+struct ShadowJoin {
+    double time; // engine seconds
+    Role role;
+};
+
+struct ShadowResult {
+    long long parties = 0;
+    long long coldStarts = 0;
+    long long stillQueued = 0;
+    std::vector<double> waits; // players still queued at the end count with their wait so far
+    double busySeconds = 0.0; // instance time spent starting up or in a run, within the horizon
+    double cpuSeconds = 0.0;
+    int core = -1; // -1 if the thread could not be pinned
+};
+
+// The settings that can change while the engine runs. A reload builds a new one
+// and the queue manager publishes it between dispatches; readers take a snapshot
+// with currentConfig() and keep it for as long as they need consistent values.
+struct EngineConfig {
+    int instances;
+    int minTime;
+    int maxTime;
+    FairnessPolicy fairness;
+    double agingRate;
+    InstancePolicy instancePolicy; // selector type is fixed at startup; changes are reported, not applied
+    ClearTimeDistribution distribution;
+    double sigma;
+    double crashProbability;
+    double meanTimeToFailure;
+    double recoveryTime;
+    double arrivalRate;
+    uint64_t version;
+};
+
+struct TenantStats {
+    long long joins = 0;
+    long long parties = 0;
+    uint64_t waitBuckets[32] = {}; // queue waits in engine seconds, log2 ms buckets
+    double waitMax = 0.0;
+    uint64_t lagBuckets[32] = {}; // how late the host handled each event, engine seconds
+    double lagMax = 0.0;
+    double busySeconds = 0.0; // instance time started, startup included
+    double cpuSeconds = 0.0; // worker CPU spent stepping this tenant
+    long long slices = 0;
+    long long preempted = 0; // slices cut off at the quantum with work still due
+};
+
+// One line of a --host tenants file, after defaults and overrides are applied
+struct TenantSpec {
+    std::string name;
+    EngineConfig config;
+    double roleWeights[ROLE_COUNT];
+    int warmPoolSize = 0;
+    int instanceShards = 8; // power-of-two dispatch shards in this tenant's fleet
+    int dungeonTypes = 1;
+    double coldStartTime = 0.0; // seconds to spin up a cold instance
+    double mapLoadTime = 0.0; // seconds to load another dungeon's map
+    double cpuShare = 1.0; // relative weight when tenants compete for the workers
+};
+
+// One matchmaker world inside --host: its own settings, role queues and fleet, run as
+// a discrete-event engine against the host clock, so an idle tenant costs memory but
+// no thread and no CPU. The host never steps one tenant on two workers at once.
+class Tenant {
+public:
+    TenantSpec spec;
+    double virtualRuntime = 0.0; // CPU seconds used divided by spec.cpuShare
+    TenantStats stats;
+
+    virtual ~Tenant() {}
+    // Handles every event due by `now` in time order, stopping early once sliceEnd
+    // passes. Returns true if it stopped with events still due.
+    virtual bool step(double now, Clock::time_point sliceEnd) = 0;
+    virtual double nextDue() const = 0; // engine seconds of the next arrival or completion
+    virtual long long queued() const = 0;
+};
+
+// Shared scheduler state for --host, guarded by mutex. Tenants with nothing due sleep
+// in a heap keyed on their next event; due tenants wait in a heap keyed on virtual
+// runtime, so the one that has had the least CPU for its share runs next.
+struct TenantHost {
+    typedef std::pair<double, int> Entry;
+    std::vector<std::unique_ptr<Tenant>> tenants;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> sleeping;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> ready;
+    double minVirtualRuntime = 0.0;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stop = false;
+    Clock::time_point start;
+    Clock::duration quantum;
+};
+
+InstanceTable instances;
+std::vector<int> freedInstances; // finished since the manager last looked, guarded by instancesMutex
+int busyInstances = 0; // instances active or recovering, guarded by instancesMutex
+std::mutex instancesMutex;
+QueueMutex queueMutex;
+std::condition_variable cv;
+std::atomic<bool> shutdown(false);
+std::atomic<bool> arrivalsStop(false); // ends generateArrivals ahead of shutdown, so its last batch is queued
+
+int tanksAvailable;
+int healersAvailable;
+int dpsAvailable;
+
+RoleQueue roleQueues[ROLE_COUNT];
+FairnessPolicy fairnessPolicy = FairnessPolicy::Aging;
+double agingRate = 1.0; // bonus seconds per second waited
+std::vector<double> matchWaits; // seconds each matched player spent queued, guarded by instancesMutex
+InstancePolicy instancePolicy = InstancePolicy::LowestIndex;
+int dungeonTypes = 1;
+double coldStartTime = 0.0; // seconds to spin up an instance and load its map
+double mapLoadTime = 0.0; // seconds for a warm instance to switch dungeons
+int warmPoolSize = 0; // idle instances kept spun up
+std::vector<double> startupWaits; // seconds each party spent waiting on instance startup, guarded by instancesMutex
+double crashProbability = 0.0; // chance that any one run crashes partway through
+double meanTimeToFailure = 0.0; // seconds, exponential time to failure while running; 0 disables
+double recoveryTime = 0.0; // seconds a crashed instance stays out of service
+std::deque<Party> requeuedParties; // crashed parties, dispatched ahead of new ones, guarded by queueMutex
+PlayerSlotMap playerSlots; // matched players until their party completes, guarded by queueMutex
+std::atomic<bool> slotMapFullReported(false); // set once playerSlots runs out of handles
+PlayerIdIndex activePlayers; // ids queued or in a party, guarded by queueMutex
+long long duplicateJoins = 0; // joins turned away because the id was already active, guarded by queueMutex
+// Ids waiting in each role queue with the stamp of the join that queued them,
+// guarded by queueMutex. A leave only erases the id here; the queue entry it
+// leaves behind is skipped when popped, so a leave costs a hash erase instead of
+// a search through the queue. An entry is live only while its stamp matches, so
+// one left behind by an earlier join of the same id never stands in for the
+// current one.
+PlayerIdIndex queuedIds[ROLE_COUNT] = { PlayerIdIndex(true), PlayerIdIndex(true), PlayerIdIndex(true) };
+uint32_t joinStamps[ROLE_COUNT] = {}; // last stamp issued per role queue, guarded by queueMutex
+long long queueLeaves = 0; // guarded by queueMutex
+double admissionRate = 0.0; // joins per engine second allowed from each source, 0 for no limit
+double admissionBurst = 20.0; // joins a quiet source may send at once
+int admissionSources = 64; // sources the daemon's arrivals are spread over
+int maxQueueSize = 0; // players waiting across all roles before joins are turned away, 0 for no cap
+// Per-source rate limit as GCRA, the usual one-word form of a token bucket: the
+// engine nanosecond at which the source's bucket would be back to full. Sources
+// hash onto admissionSlots entries, and all of this is read and updated without
+// queueMutex, so a rejected join never touches the queue lock.
+std::unique_ptr<std::atomic<int64_t>[]> admissionBuckets;
+int admissionSlots = 0;
+std::atomic<long long> rejectedRateLimited(0);
+std::atomic<long long> rejectedQueueFull(0);
+long long missedLeaves = 0; // leaves for players not waiting, guarded by queueMutex
+// Skill matching replaces the role queues when skillWindow > 0. A party forms around
+// an anchor, one of the longest-waiting players, from players rated within the
+// anchor's window: skillWindow, plus skillWidenRate per engine second it has waited,
+// up to skillMaxWindow.
+SkillIndex skillIndex[ROLE_COUNT]; // guarded by queueMutex
+uint64_t skillIndexEpoch = 0; // bumped when compaction moves index entries, guarded by queueMutex
+double skillWindow = 0.0; // rating points either side of the anchor, 0 turns skill matching off
+double skillWidenRate = 10.0; // rating points added to the window per second waited
+double skillMaxWindow = 800.0;
+double skillMean = 1500.0; // rating distribution for generated players
+double skillDeviation = 350.0;
+const int SKILL_ANCHORS = 4; // oldest players per role tried as anchors per search
+long long skillSpreadCounts[400] = {}; // matched parties by rating spread, 10-point bins, guarded by queueMutex
+double skillWindowTotal = 0.0; // sum of anchor windows at match, guarded by queueMutex
+double joinBatchWindow = 0.001; // seconds of daemon arrivals gathered into one applyQueueBatch
+double leaveFraction = 0.0; // share of daemon arrivals followed by a recent joiner giving up
+double workLost = 0.0; // seconds of startup and play thrown away by crashes, guarded by instancesMutex
+std::vector<double> recoveryLatencies; // crash to re-entry per requeued party, guarded by instancesMutex
+int nextPartyId = 1; // guarded by queueMutex
+Clock::time_point engineStart = Clock::now();
+std::string eventLogPath; // empty disables the event log
+EventExporter* eventExporter = nullptr;
+DisplayMode displayMode = DisplayMode::Log;
+int dashboardFps = 10;
+LiveStats liveStats;
+std::atomic<bool> dashboardStop(false);
+const int LOG_FLUSH_MS = 100; // display log batches party events this often
+LogBuffer logBuffer;
+std::atomic<bool> logStop(false);
+bool daemonMode = false; // keep running on streaming arrivals until stopped
+double daemonDuration = 0.0; // engine seconds before a daemon stops itself; 0 runs until a signal
+double timeScale = 1.0; // real seconds per engine second; below 1 runs accelerated
+double arrivalRate = 0.0; // players joining per engine second in daemon mode
+std::mutex rollingMutex;
+RollingStats rollingStats;
+volatile std::sig_atomic_t stopRequested = 0;
+// Stats text for SIGUSR1, rendered ahead of time because the handler may only write()
+char statsSnapshot[2][4096];
+size_t statsSnapshotLength[2] = { 0, 0 };
+std::atomic<int> statsSnapshotIndex(0);
+std::condition_variable_any queueCv; // players arrived or a party was requeued, used with queueMutex
+std::string joinFilePath; // seeds the queues instead of num-tank/num-healer/num-dps when set
+int lastIngestedId = 0;
+ClearTimeDistribution clearTimeDistribution = ClearTimeDistribution::Uniform;
+double clearTimeSigma = 0.3; // lognormal shape, in log-seconds
+uint64_t rngSeed = 0; // key for every clear time and crash draw; 0 in config.txt picks one at startup
+int simInstances = 4096; // fleet size for --simulate
+int simShards = 16; // logical processes the simulated fleet is split into
+double simHours = 1.0; // simulated time per --simulate run
+int simThreads = 0; // worker threads for the parallel backends, 0 for one per core
+const uint64_t simSeed = 0x4C46470000000001ULL;
+Scenario scenario; // set by --scenario, read-only once the engine starts
+bool scenarioLoaded = false;
+std::atomic<int> instancesOnline(INT_MAX); // fleet size less failed instances while a scenario runs
+std::atomic<int> requestedFleetSize(-1); // applied by the queue manager, -1 when nothing is pending
+const char* const configPath = "config.txt";
+std::shared_ptr<const EngineConfig> liveConfig; // use std::atomic_load/atomic_store
+std::shared_ptr<const EngineConfig> pendingConfig; // validated reload waiting for the queue manager
+ArrivalModel arrivalModel = ArrivalModel::Steady;
+double diurnalPeakHour = 20.0; // hour of day the curve peaks
+double diurnalSwing = 0.6; // peak is (1 + swing) times the mean rate, the trough (1 - swing)
+std::string arrivalTracePath; // per-minute join counts for the trace model
+double shadowHours = 4.0; // engine hours of arrivals replayed into each --shadow variant
+int hostThreads = 0; // --host workers shared by every tenant, 0 for one per core
+double hostQuantum = 0.002; // seconds a tenant may run before the worker moves on
+HourlyReport hourlyReport;
+
+int maxInstances; // n
+int minTime; // t1
+int maxTime; // t2
+
+void readConfig(int* n, int* t, int* h, int* d, int* t1, int* t2);
+Philox4x32 runDraws(int instanceId, int partyId, int attempt, RngStream stream);
+int getRandomClearTime(int instanceId, int partyId, int attempt);
+int clearTimeFrom(const EngineConfig& config, const Philox4x32& draws);
+double getCrashTime(int clearTime, int instanceId, int partyId, int attempt);
+bool canFormParty(SkillGroup* picked = nullptr);
+bool canEverFormParty();
+uint16_t drawRating(int playerId);
+bool findSkillGroup(Clock::time_point now, bool widest, SkillGroup& group);
+Party formSkillParty(const SkillGroup* picked);
+void compactSkillIndex(Role role);
+void printSkillReport();
+double benchmarkSkillIndex(int players, int parties, double* spread);
+double benchmarkSkillNaive(int players, int parties, double* spread);
+void benchmarkSkillMatching();
+bool hasRequeuedParty();
+int maxPossibleParties();
+Party formParty(const SkillGroup* picked = nullptr);
+int findAvailableInstance();
+void displayStatus();
+void runInstance(int instanceId, Party party, double startupCost);
+void queueManager();
+template <typename Selector> void runQueueManager();
+void wakeInstanceWaiters();
+void requestFleetResize(int target);
+EngineConfig configFromGlobals();
+std::shared_ptr<const EngineConfig> currentConfig();
+void publishConfig(const EngineConfig& config);
+bool parseLiveConfig(std::istream& configFile, EngineConfig& config, std::string& error);
+bool reloadConfig();
+template <typename Selector> void applyConfig(const std::shared_ptr<const EngineConfig>& next);
+long long configModifiedTime();
+void watchConfig();
+template <typename Selector> void resizeFleet(WarmPool<Selector>& pool, int target);
+void displaySummary();
+FairnessPolicy parseFairnessPolicy(const std::string& name);
+const char* fairnessPolicyName(FairnessPolicy policy);
+bool enqueuePlayer(const Player& player, int source = ADMISSION_INTERNAL);
+void initAdmission();
+int64_t admissionClock();
+QueueResult admitJoin(int source);
+void refundAdmission(int source);
+double admissionRetryAfter(int source);
+double queuePressure();
+bool leaveQueue(int playerId);
+size_t applyQueueBatch(const std::vector<QueueRequest>& batch, std::vector<QueueResult>& results);
+QueueResult joinLocked(const Player& player);
+bool leaveLocked(int playerId, Role* role);
+Player popQueued(Role role);
+void compactRoleQueue(Role role, FairnessPolicy policy, double rate);
+void reorderRoleQueues(FairnessPolicy policy, double rate);
+double benchmarkQueueBatch(int threads, int batchSize, int itemsPerThread);
+void benchmarkBatching();
+void resetQueuesForBenchmark();
+double benchmarkAdmissionCase(int threads, int joinsPerThread);
+void benchmarkAdmission();
+double percentile(std::vector<double> values, double p);
+double jainIndex(const std::vector<double>& values);
+void benchmarkFairness();
+InstancePolicy parseInstancePolicy(const std::string& name);
+const char* instancePolicyName(InstancePolicy policy);
+template <typename Selector> void benchmarkSelector(const char* name, int numInstances);
+void benchmarkInstanceSelection();
+template <typename Selector> void benchmarkShardDispatch(const char* name, int numInstances, int shardCount);
+void benchmarkDispatch();
+void benchmarkWarmupStrategy(const char* name, int poolSize, bool affinity, double arrivalRate);
+void benchmarkWarmup();
+void benchmarkFailureCase(int numInstances, double crashChance, double recovery);
+void benchmarkFailures();
+void recordEvent(EventType type, int subject, int instance, int value);
+size_t countByte(const uint8_t* data, size_t size, uint8_t value);
+size_t decodeVarints(const uint8_t* data, size_t size, uint64_t* out, size_t count);
+void readEventLog(const std::string& path);
+void publishRoleDepths();
+double threadCpuSeconds();
+std::string renderDashboard(const std::vector<uint64_t>& throughputHistory);
+void runDashboard(double* cpuSeconds, int* frames);
+void runLogWriter();
+double engineSeconds(Clock::time_point from, Clock::time_point to);
+long long engineNow();
+void sleepEngineSeconds(double seconds);
+void generateArrivals(int tankWeight, int healerWeight, int dpsWeight, int firstPlayerId);
+std::string renderRollingStats();
+void publishStatsSnapshot();
+void handleStopSignal(int);
+void handleStatsSignal(int);
+long currentRssKb();
+int runDaemon(int tankWeight, int healerWeight, int dpsWeight, int firstPlayerId, double soakHours);
+size_t parseJoinCsv(const char* data, size_t begin, size_t end, size_t fileSize, std::vector<JoinRecord>& out);
+size_t parseJoinBinary(const char* data, size_t first, size_t last, std::vector<JoinRecord>& out);
+bool ingestJoinFile(const std::string& path);
+void generateJoinFile(const std::string& path, long long count);
+template <typename Lock> double benchmarkLockedCounters(int threads, int opsPerThread);
+double benchmarkLockFreeCounters(int threads, int opsPerThread);
+void benchmarkLocks();
+template <typename IdSet> void benchmarkJoinIndex(const char* name, const std::vector<int>& ops, size_t live);
+void benchmarkJoins();
+bool parseScenarioText(const char* data, size_t size, Scenario& scenario);
+bool parseScenarioBinary(const char* data, size_t size, Scenario& scenario);
+bool loadScenario(const std::string& path, Scenario& scenario);
+bool compileScenario(const std::string& inPath, const std::string& outPath);
+Role scenarioRole(const ScenarioPhase& phase, double u);
+void hourlyRoleMix(int hour, int tankWeight, int healerWeight, int dpsWeight, double* mix);
+bool loadArrivalTrace(const std::string& path, std::vector<double>& perMinute);
+bool buildArrivalScenario(double meanPerSecond, int tankWeight, int healerWeight, int dpsWeight, Scenario& out);
+void printHourlyReport();
+bool parseShadowVariant(const std::string& spec, ShadowVariant& variant);
+void generateShadowStream(double hours, int baseInstances, int tankWeight, int healerWeight, int dpsWeight, std::vector<ShadowJoin>& out);
+bool pinThreadToCore(int core);
+template <typename Selector> void runShadowEngine(const ShadowVariant& variant, const std::vector<ShadowJoin>& joins, double horizon, ShadowResult& result);
+void runShadowVariant(const ShadowVariant& variant, const std::vector<ShadowJoin>& joins, double horizon, int core, ShadowResult* result);
+int runShadow(const std::vector<std::string>& specs, int n, int tankWeight, int healerWeight, int dpsWeight);
+Tenant* makeTenant(int number, const TenantSpec& spec);
+bool loadTenants(const std::string& path, const EngineConfig& base, int tankWeight, int healerWeight, int dpsWeight,
+    std::vector<std::unique_ptr<Tenant>>& out);
+void runHostWorker(TenantHost* host, double* cpuSeconds);
+int runHost(const std::string& tenantsPath, int tankWeight, int healerWeight, int dpsWeight);
+uint64_t simHash(uint64_t shard, uint64_t counter, uint64_t stream);
+double simUnit(uint64_t bits);
+int simShare(int total, int shards, int id);
+void simInitShard(SimShard& shard, int id, const SimParams& params, SimOutput& out);
+int64_t simClearTimeMs(SimShard& shard, uint64_t partySeq, const SimParams& params);
+void simHandle(SimShard& shard, const SimEvent& event, const SimParams& params, SimOutput& out);
+SimResult simCollect(const std::vector<SimShard*>& shards);
+SimResult runSequentialSim(const SimParams& params);
+SimResult runTimeWarpSim(const SimParams& params, int threads);
+SimResult runConservativeSim(const SimParams& params, int threads);
+void printSimResult(const char* backend, int threads, const SimParams& params, const SimResult& result, double wallSeconds);
+int runSimulation(const std::string& backend, int t1, int t2, const Scenario* scenario);
+void benchmarkSimulation(int threads);
+int benchmarkSampling();
+
+
+void readConfig(int* n, int* t, int* h, int* d, int* t1, int* t2) {
+    // Open the config file
+    std::ifstream configFile(configPath);
+    if (!configFile.is_open()) {
+        std::cerr << "Error: Could not open config file!" << std::endl;
+        return;
+    }
+
+    // Read the file line by line
+    std::string line;
+    while (std::getline(configFile, line)) {
+        std::istringstream iss(line);
+        std::string key;
+        iss >> key; // Read the first word
+
+        if (key == "max-num-instances") {
+            iss >> *n;
+            if (*n <= 0) {
+                std::cerr << "Warning: Invalid value for max-num-instances in config file. Must be > 0." << std::endl;
+                *n = 0; 
+            }
+            else if (*n > InstanceTable::capacity) {
+                std::cerr << "Warning: Invalid value for max-num-instances in config file. Must be <= " << InstanceTable::capacity
+                    << "; using " << InstanceTable::capacity << "." << std::endl;
+                *n = InstanceTable::capacity;
+            }
+        }
+        else if (key == "num-tank") {
+            iss >> *t;
+            if (*t <= 0) {
+                std::cerr << "Warning: Invalid value for num-tank in config file. Must be > 0." << std::endl;
+                *t = 0; 
+            }
+        }
+        else if (key == "num-healer") {
+            iss >> *h;
+            if (*h <= 0) {
+                std::cerr << "Warning: Invalid value for num-healer in config file. Must be > 0." << std::endl;
+                *h = 0; 
+            }
+        }
+        else if (key == "num-dps") {
+            iss >> *d;
+            if (*d <= 0) {
+                std::cerr << "Warning: Invalid value for num-dps in config file. Must be > 0." << std::endl;
+                *d = 0; 
+            }
+        }
+        else if (key == "min-time") {
+            iss >> *t1;
+            if (*t1 <= 0) {
+                std::cerr << "Warning: Invalid value for min-time in config file. Must be > 0." << std::endl;
+                *t1 = 0; 
+            }
+        }
+        else if (key == "max-time") {
+            iss >> *t2;
+        }
+        else if (key == "fairness-policy") {
+            std::string name;
+            iss >> name;
+            fairnessPolicy = parseFairnessPolicy(name);
+        }
+        else if (key == "instance-policy") {
+            std::string name;
+            iss >> name;
+            instancePolicy = parseInstancePolicy(name);
+        }
+        else if (key == "clear-time-distribution") {
+            std::string value;
+            iss >> value;
+            if (value == "uniform") clearTimeDistribution = ClearTimeDistribution::Uniform;
+            else if (value == "lognormal") clearTimeDistribution = ClearTimeDistribution::LogNormal;
+            else std::cerr << "Warning: Unknown clear-time-distribution '" << value << "' in config file. Using uniform." << std::endl;
+        }
+        else if (key == "clear-time-sigma") {
+            iss >> clearTimeSigma;
+            if (clearTimeSigma <= 0 || clearTimeSigma > 4) {
+                std::cerr << "Warning: Invalid value for clear-time-sigma in config file. Must be in (0, 4]." << std::endl;
+                clearTimeSigma = 0.3;
+            }
+        }
+        else if (key == "seed") {
+            iss >> rngSeed;
+        }
+        else if (key == "arrival-model") {
+            std::string value;
+            iss >> value;
+            if (value == "steady") arrivalModel = ArrivalModel::Steady;
+            else if (value == "diurnal") arrivalModel = ArrivalModel::Diurnal;
+            else if (value == "trace") arrivalModel = ArrivalModel::Trace;
+            else std::cerr << "Warning: Unknown arrival-model '" << value << "' in config file. Using steady." << std::endl;
+        }
+        else if (key == "diurnal-peak-hour") {
+            iss >> diurnalPeakHour;
+            if (diurnalPeakHour < 0 || diurnalPeakHour >= 24) {
+                std::cerr << "Warning: Invalid value for diurnal-peak-hour in config file. Must be in [0, 24)." << std::endl;
+                diurnalPeakHour = 20.0;
+            }
+        }
+        else if (key == "diurnal-swing") {
+            iss >> diurnalSwing;
+            if (diurnalSwing < 0 || diurnalSwing > 1) {
+                std::cerr << "Warning: Invalid value for diurnal-swing in config file. Must be in [0, 1]." << std::endl;
+                diurnalSwing = 0.6;
+            }
+        }
+        else if (key == "arrival-trace") {
+            iss >> arrivalTracePath;
+        }
+        else if (key == "shadow-hours") {
+            iss >> shadowHours;
+            if (shadowHours <= 0) {
+                std::cerr << "Warning: Invalid value for shadow-hours in config file. Must be > 0." << std::endl;
+                shadowHours = 4.0;
+            }
+        }
+        else if (key == "skill-window") {
+            iss >> skillWindow;
+            if (skillWindow < 0) {
+                std::cerr << "Warning: Invalid value for skill-window in config file. Must be >= 0." << std::endl;
+                skillWindow = 0.0;
+            }
+        }
+        else if (key == "skill-widen-rate") {
+            iss >> skillWidenRate;
+            if (skillWidenRate < 0) {
+                std::cerr << "Warning: Invalid value for skill-widen-rate in config file. Must be >= 0." << std::endl;
+                skillWidenRate = 10.0;
+            }
+        }
+        else if (key == "skill-max-window") {
+            iss >> skillMaxWindow;
+            if (skillMaxWindow <= 0) {
+                std::cerr << "Warning: Invalid value for skill-max-window in config file. Must be > 0." << std::endl;
+                skillMaxWindow = 800.0;
+            }
+        }
+        else if (key == "skill-mean") {
+            iss >> skillMean;
+            if (skillMean < 0 || skillMean > 3999) {
+                std::cerr << "Warning: Invalid value for skill-mean in config file. Must be in [0, 3999]." << std::endl;
+                skillMean = 1500.0;
+            }
+        }
+        else if (key == "skill-deviation") {
+            iss >> skillDeviation;
+            if (skillDeviation < 0) {
+                std::cerr << "Warning: Invalid value for skill-deviation in config file. Must be >= 0." << std::endl;
+                skillDeviation = 350.0;
+            }
+        }
+        else if (key == "admission-rate") {
+            iss >> admissionRate;
+            if (admissionRate < 0) {
+                std::cerr << "Warning: Invalid value for admission-rate in config file. Must be >= 0." << std::endl;
+                admissionRate = 0.0;
+            }
+        }
+        else if (key == "admission-burst") {
+            iss >> admissionBurst;
+            if (admissionBurst < 1) {
+                std::cerr << "Warning: Invalid value for admission-burst in config file. Must be >= 1." << std::endl;
+                admissionBurst = 20.0;
+            }
+        }
+        else if (key == "admission-sources") {
+            iss >> admissionSources;
+            if (admissionSources <= 0) {
+                std::cerr << "Warning: Invalid value for admission-sources in config file. Must be > 0." << std::endl;
+                admissionSources = 64;
+            }
+        }
+        else if (key == "max-queue-size") {
+            iss >> maxQueueSize;
+            if (maxQueueSize < 0) {
+                std::cerr << "Warning: Invalid value for max-queue-size in config file. Must be >= 0." << std::endl;
+                maxQueueSize = 0;
+            }
+        }
+        else if (key == "join-batch-ms") {
+            double ms = 0.0;
+            iss >> ms;
+            if (ms < 0) {
+                std::cerr << "Warning: Invalid value for join-batch-ms in config file. Must be >= 0." << std::endl;
+                ms = 1.0;
+            }
+            joinBatchWindow = ms / 1000.0;
+        }
+        else if (key == "leave-fraction") {
+            iss >> leaveFraction;
+            if (leaveFraction < 0 || leaveFraction > 1) {
+                std::cerr << "Warning: Invalid value for leave-fraction in config file. Must be in [0, 1]." << std::endl;
+                leaveFraction = 0.0;
+            }
+        }
+        else if (key == "host-threads") {
+            iss >> hostThreads;
+            if (hostThreads < 0) {
+                std::cerr << "Warning: Invalid value for host-threads in config file. Must be >= 0." << std::endl;
+                hostThreads = 0;
+            }
+        }
+        else if (key == "host-quantum-ms") {
+            double ms = 0.0;
+            iss >> ms;
+            if (ms <= 0) {
+                std::cerr << "Warning: Invalid value for host-quantum-ms in config file. Must be > 0." << std::endl;
+                ms = 2.0;
+            }
+            hostQuantum = ms / 1000.0;
+        }
+        else if (key == "instance-shards") {
+            iss >> instanceShards;
+            if (instanceShards <= 0) {
+                std::cerr << "Warning: Invalid value for instance-shards in config file. Must be > 0." << std::endl;
+                instanceShards = 8;
+            }
+        }
+        else if (key == "dungeon-types") {
+            iss >> dungeonTypes;
+            if (dungeonTypes <= 0) {
+                std::cerr << "Warning: Invalid value for dungeon-types in config file. Must be > 0." << std::endl;
+                dungeonTypes = 1;
+            }
+        }
+        else if (key == "cold-start-time") {
+            iss >> coldStartTime;
+            if (coldStartTime < 0) {
+                std::cerr << "Warning: Invalid value for cold-start-time in config file. Must be >= 0." << std::endl;
+                coldStartTime = 0.0;
+            }
+        }
+        else if (key == "map-load-time") {
+            iss >> mapLoadTime;
+            if (mapLoadTime < 0) {
+                std::cerr << "Warning: Invalid value for map-load-time in config file. Must be >= 0." << std::endl;
+                mapLoadTime = 0.0;
+            }
+        }
+        else if (key == "warm-pool-size") {
+            iss >> warmPoolSize;
+            if (warmPoolSize < 0) {
+                std::cerr << "Warning: Invalid value for warm-pool-size in config file. Must be >= 0." << std::endl;
+                warmPoolSize = 0;
+            }
+        }
+        else if (key == "crash-probability") {
+            iss >> crashProbability;
+            if (crashProbability < 0 || crashProbability > 1) {
+                std::cerr << "Warning: Invalid value for crash-probability in config file. Must be between 0 and 1." << std::endl;
+                crashProbability = 0.0;
+            }
+        }
+        else if (key == "mean-time-to-failure") {
+            iss >> meanTimeToFailure;
+            if (meanTimeToFailure < 0) {
+                std::cerr << "Warning: Invalid value for mean-time-to-failure in config file. Must be >= 0." << std::endl;
+                meanTimeToFailure = 0.0;
+            }
+        }
+        else if (key == "recovery-time") {
+            iss >> recoveryTime;
+            if (recoveryTime < 0) {
+                std::cerr << "Warning: Invalid value for recovery-time in config file. Must be >= 0." << std::endl;
+                recoveryTime = 0.0;
+            }
+        }
+        else if (key == "display") {
+            std::string mode;
+            iss >> mode;
+            if (mode == "dashboard") displayMode = DisplayMode::Dashboard;
+            else if (mode == "quiet") displayMode = DisplayMode::Quiet;
+            else if (mode == "log") displayMode = DisplayMode::Log;
+            else std::cerr << "Warning: Unknown display '" << mode << "' in config file. Using log." << std::endl;
+        }
+        else if (key == "dashboard-fps") {
+            iss >> dashboardFps;
+            if (dashboardFps <= 0 || dashboardFps > 60) {
+                std::cerr << "Warning: Invalid value for dashboard-fps in config file. Must be 1-60." << std::endl;
+                dashboardFps = 10;
+            }
+        }
+        else if (key == "daemon") {
+            iss >> daemonMode;
+        }
+        else if (key == "daemon-duration") {
+            iss >> daemonDuration;
+            if (daemonDuration < 0) {
+                std::cerr << "Warning: Invalid value for daemon-duration in config file. Must be >= 0." << std::endl;
+                daemonDuration = 0.0;
+            }
+        }
+        else if (key == "time-scale") {
+            iss >> timeScale;
+            if (timeScale <= 0) {
+                std::cerr << "Warning: Invalid value for time-scale in config file. Must be > 0." << std::endl;
+                timeScale = 1.0;
+            }
+        }
+        else if (key == "arrival-rate") {
+            iss >> arrivalRate;
+            if (arrivalRate < 0) {
+                std::cerr << "Warning: Invalid value for arrival-rate in config file. Must be >= 0." << std::endl;
+                arrivalRate = 0.0;
+            }
+        }
+        else if (key == "sim-instances") {
+            iss >> simInstances;
+            if (simInstances <= 0) {
+                std::cerr << "Warning: Invalid value for sim-instances in config file. Must be > 0." << std::endl;
+                simInstances = 4096;
+            }
+        }
+        else if (key == "sim-shards") {
+            iss >> simShards;
+            if (simShards <= 0) {
+                std::cerr << "Warning: Invalid value for sim-shards in config file. Must be > 0." << std::endl;
+                simShards = 16;
+            }
+        }
+        else if (key == "sim-hours") {
+            iss >> simHours;
+            if (simHours <= 0) {
+                std::cerr << "Warning: Invalid value for sim-hours in config file. Must be > 0." << std::endl;
+                simHours = 1.0;
+            }
+        }
+        else if (key == "sim-threads") {
+            iss >> simThreads;
+            if (simThreads < 0) {
+                std::cerr << "Warning: Invalid value for sim-threads in config file. Must be >= 0." << std::endl;
+                simThreads = 0;
+            }
+        }
+        else if (key == "join-file") {
+            iss >> joinFilePath;
+        }
+        else if (key == "event-log") {
+            iss >> eventLogPath;
+        }
+        else if (key == "aging-rate") {
+            iss >> agingRate;
+            if (agingRate < 0) {
+                std::cerr << "Warning: Invalid value for aging-rate in config file. Must be >= 0." << std::endl;
+                agingRate = 1.0;
+            }
+        }
+    }
+
+    if (*t1 >= *t2 && *t1 > 0 && *t2 > 0) {
+        std::cerr << "Warning: min-time must be less than max-time in config file." << std::endl;
+        *t2 = 0; 
+    }
+
+    // Close the file
+    configFile.close();
+}
+
+// Random block for one run of a party on an instance. Counter is (instance, party,
+// attempt, stream), so the same seed gives the same draws however threads interleave.
+Philox4x32 runDraws(int instanceId, int partyId, int attempt, RngStream stream) {
+    return Philox4x32(rngSeed, static_cast<uint32_t>(instanceId), static_cast<uint32_t>(partyId),
+        static_cast<uint32_t>(attempt), stream);
+}
+
+int getRandomClearTime(int instanceId, int partyId, int attempt) {
+    return clearTimeFrom(*currentConfig(), runDraws(instanceId, partyId, attempt, RNG_CLEAR_TIME));
+}
+
+int clearTimeFrom(const EngineConfig& config, const Philox4x32& draws) {
+    if (config.distribution == ClearTimeDistribution::LogNormal) {
+        double u1 = ClearTimeSampler::unit((static_cast<uint64_t>(draws.v[0]) << 32) | draws.v[1]);
+        double u2 = ClearTimeSampler::unit((static_cast<uint64_t>(draws.v[2]) << 32) | draws.v[3]);
+        double mu = 0.5 * (ClearTimeSampler::polyLog(config.minTime) + ClearTimeSampler::polyLog(config.maxTime));
+        return static_cast<int>(std::lround(ClearTimeSampler::logNormal(u1, u2, config.minTime, config.maxTime, mu, config.sigma)));
+    }
+    return config.minTime + draws.below(0, config.maxTime - config.minTime + 1);
+}
+
+// Seconds into a run at which the instance crashes, or -1 if the run completes
+double getCrashTime(int clearTime, int instanceId, int partyId, int attempt) {
+    std::shared_ptr<const EngineConfig> config = currentConfig();
+    if (config->crashProbability <= 0 && config->meanTimeToFailure <= 0) return -1.0;
+    Philox4x32 draws = runDraws(instanceId, partyId, attempt, RNG_CRASH);
+    double crashAt = -1.0;
+    if (config->crashProbability > 0 && draws.uniform(0) < config->crashProbability) {
+        crashAt = draws.uniform(1) * clearTime;
+    }
+    if (config->meanTimeToFailure > 0) {
+        double timeToFailure = -std::log(1.0 - draws.uniform(2)) * config->meanTimeToFailure;
+        if (timeToFailure < clearTime && (crashAt < 0 || timeToFailure < crashAt)) {
+            crashAt = timeToFailure;
+        }
+    }
+    return crashAt;
+}
+
+bool hasRequeuedParty() {
+    std::lock_guard<QueueMutex> lock(queueMutex);
+    return !requeuedParties.empty();
+}
+
+// With skill matching, the group found is left in `picked` for formParty to take
+bool canFormParty(SkillGroup* picked) {
+    std::lock_guard<QueueMutex> lock(queueMutex);
+    if (tanksAvailable < 1 || healersAvailable < 1 || dpsAvailable < 3) return false;
+    SkillGroup group;
+    return skillWindow <= 0 || findSkillGroup(Clock::now(), false, picked != nullptr ? *picked : group);
+}
+
+// Whether a party could form once every window has widened to its cap, so a run
+// does not end while skill matching is only waiting for windows to grow
+bool canEverFormParty() {
+    std::lock_guard<QueueMutex> lock(queueMutex);
+    if (tanksAvailable < 1 || healersAvailable < 1 || dpsAvailable < 3) return false;
+    SkillGroup group;
+    return skillWindow <= 0 || findSkillGroup(Clock::now(), true, group);
+}
+
+// Normal around skillMean, clamped to the 0-3999 scale, from the player's own
+// Philox block so a player keeps its rating across runs with the same seed
+uint16_t drawRating(int playerId) {
+    Philox4x32 draws(rngSeed, static_cast<uint32_t>(playerId), 0, 0, RNG_RATING);
+    double z = std::sqrt(-2.0 * std::log(1.0 - draws.uniform(0))) * std::cos(6.283185307179586 * draws.uniform(1));
+    return static_cast<uint16_t>(std::min(3999.0, std::max(0.0, skillMean + skillDeviation * z)));
+}
+
+// Caller holds queueMutex. Tries the SKILL_ANCHORS oldest players of each role as
+// anchors, oldest first, and for each asks the other roles' indexes for the
+// nearest-rated players inside its window. Each try is a few Fenwick range counts
+// plus walks of the buckets the window covers, which pass over matched and
+// departed entries not yet trimmed, so it costs O(log buckets) to reject a window
+// and up to the entries in those buckets, live or dead, to fill one; compaction
+// keeps the dead no more than the live plus 1024. Pointers in the group stay valid
+// while skillIndexEpoch is unchanged.
+bool findSkillGroup(Clock::time_point now, bool widest, SkillGroup& group) {
+    const Player* anchors[ROLE_COUNT * SKILL_ANCHORS];
+    int anchorCount = 0;
+    for (int role = 0; role < ROLE_COUNT; role++) {
+        anchorCount += skillIndex[role].oldest(SKILL_ANCHORS, [role](const Player& player) {
+            return queuedIds[role].contains(player.id, player.joinStamp);
+        }, anchors + anchorCount);
+    }
+    for (int i = 1; i < anchorCount; i++) { // at most a dozen, oldest first
+        for (int j = i; j > 0 && anchors[j]->joinTime < anchors[j - 1]->joinTime; j--) std::swap(anchors[j], anchors[j - 1]);
+    }
+
+    const int slots[ROLE_COUNT] = { 1, 1, 3 };
+    for (int a = 0; a < anchorCount; a++) {
+        const Player& anchor = *anchors[a];
+        double window = widest ? skillMaxWindow :
+            std::min(skillMaxWindow, skillWindow + skillWidenRate * std::max(0.0, std::chrono::duration<double>(now - anchor.joinTime).count() / timeScale));
+        int low = static_cast<int>(anchor.rating - window);
+        int high = static_cast<int>(anchor.rating + window);
+        const Player* picked[PARTY_SIZE] = { &anchor };
+        int taken = 1;
+        bool found = true;
+        for (int role = 0; role < ROLE_COUNT && found; role++) {
+            int needed = slots[role] - (anchor.role == role ? 1 : 0);
+            if (needed == 0) continue;
+            found = skillIndex[role].nearest(anchor.rating, low, high, needed, [role](const Player& player) {
+                return queuedIds[role].contains(player.id, player.joinStamp);
+            }, picked, taken);
+            taken += needed;
+        }
+        if (!found) continue;
+
+        int next[ROLE_COUNT] = { 0, 1, 2 }; // member slot for each role: tank, healer, then three dps
+        int lowest = anchor.rating;
+        int highest = anchor.rating;
+        for (const Player* member : picked) {
+            group.members[next[member->role]++] = member;
+            lowest = std::min<int>(lowest, member->rating);
+            highest = std::max<int>(highest, member->rating);
+        }
+        group.spread = highest - lowest;
+        group.window = window;
+        group.epoch = skillIndexEpoch;
+        return true;
+    }
+    return false;
+}
+
+// Caller holds queueMutex. Takes the group canFormParty picked if every member is
+// still waiting on the same join, else searches again; returns a party with id 0
+// if none can form any more (a leave broke it up since the check).
+Party formSkillParty(const SkillGroup* picked) {
+    Party party;
+    SkillGroup group;
+    bool reuse = picked != nullptr && picked->members[0] != nullptr && picked->epoch == skillIndexEpoch;
+    for (int i = 0; reuse && i < PARTY_SIZE; i++) {
+        const Player& member = *picked->members[i];
+        reuse = queuedIds[member.role].contains(member.id, member.joinStamp);
+    }
+    if (reuse) group = *picked;
+    else if (!findSkillGroup(Clock::now(), false, group)) return party;
+    party.id = nextPartyId++;
+    for (int i = 0; i < PARTY_SIZE; i++) {
+        Player player = *group.members[i];
+        queuedIds[player.role].erase(player.id, player.joinStamp);
+        party.members[i] = playerSlots.insert(player);
+    }
+    tanksAvailable -= 1;
+    healersAvailable -= 1;
+    dpsAvailable -= 3;
+    skillSpreadCounts[std::min(399, group.spread / 10)]++;
+    skillWindowTotal += group.window;
+    const int available[ROLE_COUNT] = { tanksAvailable, healersAvailable, dpsAvailable };
+    for (int role = 0; role < ROLE_COUNT; role++) {
+        if (skillIndex[role].size() > 2 * static_cast<size_t>(available[role]) + 1024) compactSkillIndex(static_cast<Role>(role));
+    }
+    publishRoleDepths();
+    return party;
+}
+
+// Caller holds queueMutex. Drops matched and departed entries; only the current
+// join's entry of each waiting id carries its stamp, so one stays in the buckets
+// and one in byArrival.
+void compactSkillIndex(Role role) {
+    skillIndexEpoch++;
+    auto live = [role](const Player& player) {
+        return queuedIds[role].contains(player.id, player.joinStamp);
+    };
+    skillIndex[role].retain(live, live);
+}
+
+int maxPossibleParties() {
+    std::lock_guard<QueueMutex> lock(queueMutex);
+    return std::min({ tanksAvailable, healersAvailable, dpsAvailable / 3 });
+}
+
+// Returns a party with id 0, leaving every player queued, if skill matching's group
+// broke up or the slot map has no room for five more players
+Party formParty(const SkillGroup* picked) {
+    std::lock_guard<QueueMutex> lock(queueMutex);
+    if (!playerSlots.hasRoom(PARTY_SIZE)) {
+        if (!slotMapFullReported) {
+            std::cerr << "Warning: Player slot map is out of handles; no more parties can form." << std::endl;
+            slotMapFullReported = true;
+        }
+        return Party();
+    }
+    if (skillWindow > 0) return formSkillParty(picked);
+    Party party;
+    party.id = nextPartyId++;
+    party.members[0] = playerSlots.insert(popQueued(TANK));
+    party.members[1] = playerSlots.insert(popQueued(HEALER));
+    for (int i = 2; i < PARTY_SIZE; i++) {
+        party.members[i] = playerSlots.insert(popQueued(DPS));
+    }
+    tanksAvailable -= 1;
+    healersAvailable -= 1;
+    dpsAvailable -= 3;
+    publishRoleDepths();
+    return party;
+}
+
+int findAvailableInstance() {
+    std::lock_guard<std::mutex> lock(instancesMutex);
+    for (int i = 0; i < instances.size(); i++) {
+        if (!instances[i].active) {
+            return i;
+        }
+    }
+    return -1; // No available instance
+}
+
+void displayStatus() {
+    std::lock_guard<std::mutex> lock(instancesMutex);
+    std::cout << "\n===== Current Instance Status =====" << std::endl;
+    for (const auto& instance : instances) {
+        std::cout << "Instance " << instance.id << ": "
+            << (instance.active ? "active" : instance.recovering ? "recovering" : instance.retired ? "retired" : "empty")
+            << (instance.draining ? " (draining)" : "") << std::endl;
+    }
+
+    {
+        std::lock_guard<QueueMutex> qLock(queueMutex);
+        std::cout << "\nQueue Status:" << std::endl;
+        std::cout << "Tanks: " << tanksAvailable << std::endl;
+        std::cout << "Healers: " << healersAvailable << std::endl;
+        std::cout << "DPS: " << dpsAvailable << std::endl;
+        std::cout << "===============================" << std::endl;
+    }
+}
+
+void runInstance(int instanceId, Party party, double startupCost) {
+    int clearTime = getRandomClearTime(instanceId, party.id, party.crashes);
+    double crashAfter = getCrashTime(clearTime, instanceId, party.id, party.crashes);
+
+    Clock::time_point joinTimes[PARTY_SIZE];
+    int memberCount = 0;
+    if (party.crashes == 0) {
+        std::lock_guard<QueueMutex> lock(queueMutex);
+        for (PlayerHandle handle : party.members) {
+            if (const Player* member = playerSlots.get(handle)) joinTimes[memberCount++] = member->joinTime;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(instancesMutex);
+        instances[instanceId].active = true;
+    }
+    liveStats.setState(instanceId, startupCost > 0 ? INSTANCE_STARTING : INSTANCE_BUSY);
+
+    // Spin up and/or load the map before the party can enter
+    if (startupCost > 0) {
+        sleepEngineSeconds(startupCost);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(instancesMutex);
+        Clock::time_point entered = Clock::now();
+        if (daemonMode) {
+            std::lock_guard<std::mutex> rollingLock(rollingMutex);
+            long long second = engineNow();
+            if (party.crashes == 0) {
+                for (int i = 0; i < memberCount; i++) {
+                    double wait = engineSeconds(joinTimes[i], entered);
+                    rollingStats.queueWait.add(second, wait);
+                    hourlyReport.wait(second, wait);
+                    liveStats.recordWait(wait);
+                }
+            }
+            else {
+                rollingStats.recovery.add(second, engineSeconds(party.crashedAt, entered));
+            }
+            rollingStats.startup.add(second, startupCost);
+        }
+        else {
+            if (party.crashes == 0) {
+                for (int i = 0; i < memberCount; i++) {
+                    double wait = engineSeconds(joinTimes[i], entered);
+                    matchWaits.push_back(wait);
+                    liveStats.recordWait(wait);
+                }
+            }
+            else {
+                recoveryLatencies.push_back(engineSeconds(party.crashedAt, entered));
+            }
+            startupWaits.push_back(startupCost);
+        }
+        recordEvent(EventType::Enter, party.id, instances[instanceId].id, static_cast<int>(startupCost * 1000));
+        if (displayMode == DisplayMode::Log) {
+            std::ostringstream line;
+            line << "\n> Party entering Instance " << instances[instanceId].id;
+            if (dungeonTypes > 1) line << " (dungeon " << party.dungeonType + 1 << ")";
+            if (startupCost > 0) line << " after " << startupCost << "s startup";
+            line << "\n";
+            logBuffer.append(line.str(), true);
+        }
+    }
+    liveStats.setState(instanceId, INSTANCE_BUSY);
+
+    if (crashAfter >= 0) {
+        sleepEngineSeconds(crashAfter);
+
+        {
+            std::lock_guard<std::mutex> lock(instancesMutex);
+            // Recovering before inactive, so the manager never sees an idle fleet with a party in flight
+            instances[instanceId].recovering = true;
+            instances[instanceId].active = false;
+            instances[instanceId].crashes++;
+            instances[instanceId].loadedDungeon = -1;
+            workLost += startupCost + crashAfter;
+            if (daemonMode) {
+                std::lock_guard<std::mutex> rollingLock(rollingMutex);
+                rollingStats.crashes.add(engineNow(), startupCost + crashAfter);
+            }
+            recordEvent(EventType::Crash, party.id, instances[instanceId].id, static_cast<int>(crashAfter * 1000));
+            if (displayMode == DisplayMode::Log) {
+                std::ostringstream line;
+                line << "\n> Instance " << instances[instanceId].id << " crashed after " << std::fixed
+                    << std::setprecision(1) << crashAfter << " seconds, requeueing party\n";
+                logBuffer.append(line.str());
+            }
+        }
+        liveStats.setState(instanceId, INSTANCE_RECOVERING);
+
+        party.crashes++;
+        party.crashedAt = Clock::now();
+        {
+            std::lock_guard<QueueMutex> lock(queueMutex);
+            requeuedParties.push_back(std::move(party));
+        }
+        queueCv.notify_all();
+        cv.notify_all();
+
+        sleepEngineSeconds(currentConfig()->recoveryTime);
+
+        {
+            std::lock_guard<std::mutex> lock(instancesMutex);
+            instances[instanceId].recovering = false;
+            busyInstances--;
+            freedInstances.push_back(instanceId);
+            if (displayMode == DisplayMode::Log) {
+                logBuffer.append("\n> Instance " + std::to_string(instances[instanceId].id) + " recovered\n");
+            }
+        }
+        liveStats.setState(instanceId, INSTANCE_IDLE);
+        cv.notify_all();
+        return;
+    }
+
+    sleepEngineSeconds(clearTime);
+
+    {
+        std::lock_guard<std::mutex> lock(instancesMutex);
+        instances[instanceId].active = false;
+        busyInstances--;
+        instances[instanceId].partiesServed++;
+        instances[instanceId].totalTimeServed += std::chrono::seconds(clearTime);
+        freedInstances.push_back(instanceId);
+        recordEvent(EventType::Complete, party.id, instances[instanceId].id, clearTime * 1000);
+        if (displayMode == DisplayMode::Log) {
+            logBuffer.append("\n> Party completed Instance " + std::to_string(instances[instanceId].id) + " in "
+                + std::to_string(clearTime) + " seconds\n");
+        }
+    }
+    {
+        // The party is done, so its players leave and their handles go stale
+        std::lock_guard<QueueMutex> lock(queueMutex);
+        for (PlayerHandle handle : party.members) {
+            if (const Player* member = playerSlots.get(handle)) activePlayers.erase(member->id);
+            playerSlots.remove(handle);
+        }
+    }
+    liveStats.setState(instanceId, INSTANCE_IDLE);
+    liveStats.instanceRuns[instanceId].fetch_add(1, std::memory_order_relaxed);
+    liveStats.completions.fetch_add(1, std::memory_order_relaxed);
+    if (daemonMode) {
+        std::lock_guard<std::mutex> rollingLock(rollingMutex);
+        long long second = engineNow();
+        rollingStats.completions.add(second, clearTime);
+        hourlyReport.party(second);
+    }
+
+    cv.notify_all();
+}
+
+void queueManager() {
+    // Pick the selector once so the dispatch loop is compiled per policy with no virtual calls
+    switch (instancePolicy) {
+    case InstancePolicy::RoundRobin: runQueueManager<RoundRobinSelector>(); break;
+    case InstancePolicy::LeastUtilised: runQueueManager<LeastUtilisedSelector>(); break;
+    case InstancePolicy::MostRecentlyFreed: runQueueManager<MostRecentlyFreedSelector>(); break;
+    case InstancePolicy::PowerOfTwo: runQueueManager<PowerOfTwoSelector>(); break;
+    default: runQueueManager<LowestIndexSelector>(); break;
+    }
+}
+
+template <typename Selector>
+void runQueueManager() {
+    // One thread slot per instance. An instance is only handed out again after its
+    // previous run has finished, so joining the old thread there never blocks for
+    // long and handles are reclaimed as we go instead of piling up until shutdown.
+    std::vector<std::thread> instanceThreads(instances.size());
+    WarmPool<Selector> pool(instanceShards);
+    pool.coldStartTime = coldStartTime;
+    pool.mapLoadTime = mapLoadTime;
+    pool.init(dungeonTypes, warmPoolSize);
+
+    std::mt19937 gen(static_cast<uint32_t>(rngSeed));
+    std::uniform_int_distribution<> dungeonPick(0, dungeonTypes - 1);
+
+    {
+        std::lock_guard<std::mutex> lock(instancesMutex);
+        pool.fill(instances);
+    }
+
+    while (!shutdown) {
+        std::shared_ptr<const EngineConfig> reloaded = std::atomic_exchange(&pendingConfig, std::shared_ptr<const EngineConfig>());
+        if (reloaded) applyConfig<Selector>(reloaded);
+
+        int target = requestedFleetSize.exchange(-1);
+        if (target >= 0) {
+            std::lock_guard<std::mutex> lock(instancesMutex);
+            resizeFleet(pool, target);
+            if (instanceThreads.size() < static_cast<size_t>(instances.size())) instanceThreads.resize(instances.size());
+        }
+
+        SkillGroup picked = {};
+        if (hasRequeuedParty() || canFormParty(&picked)) {
+            // Crashed parties go first and keep their dungeon. Only this thread pops
+            // requeuedParties, so the front seen here is the one taken below.
+            int dungeon = dungeonPick(gen);
+            bool requeued = false;
+            {
+                std::lock_guard<QueueMutex> lock(queueMutex);
+                if (!requeuedParties.empty()) {
+                    requeued = true;
+                    dungeon = requeuedParties.front().dungeonType;
+                }
+            }
+
+            // Get an instance ID while holding the mutex
+            int instanceId = -1;
+            Startup startup = Startup::ColdStart;
+            {
+                std::lock_guard<std::mutex> lock(instancesMutex);
+                for (int index : freedInstances) {
+                    Instance& instance = instances[index];
+                    if (instance.draining) {
+                        instance.draining = false;
+                        instance.retired = true;
+                        liveStats.setState(index, INSTANCE_IDLE);
+                        continue;
+                    }
+                    pool.release(index, instance);
+                    instance.pooled = true;
+                }
+                freedInstances.clear();
+
+                // Instances retired while idle are still in the selector; drop them as they come up
+                while (busyInstances < instancesOnline.load()) {
+                    instanceId = pool.acquire(dungeon, instances, startup);
+                    if (instanceId == -1) break;
+                    instances[instanceId].pooled = false;
+                    if (!instances[instanceId].retired) break;
+                    instanceId = -1;
+                }
+                if (instanceId != -1) {
+                    instances[instanceId].active = true;  // Mark as active
+                    busyInstances++;
+                }
+            }
+
+            if (instanceId != -1) {
+                Party party;
+                if (requeued) {
+                    std::lock_guard<QueueMutex> lock(queueMutex);
+                    party = std::move(requeuedParties.front());
+                    requeuedParties.pop_front();
+                }
+                else {
+                    // Form a party and remove players from the queue
+                    party = formParty(&picked);
+                    party.dungeonType = dungeon;
+                }
+                if (party.id == 0) {
+                    // The group seen by canFormParty has broken up, or the slot map
+                    // is full; then wait for a run to end rather than spin
+                    std::unique_lock<std::mutex> lock(instancesMutex);
+                    instances[instanceId].active = false;
+                    busyInstances--;
+                    pool.release(instanceId, instances[instanceId]);
+                    instances[instanceId].pooled = true;
+                    if (slotMapFullReported) {
+                        cv.wait_for(lock, std::chrono::milliseconds(100), []() { return !freedInstances.empty() || shutdown; });
+                    }
+                    continue;
+                }
+                recordEvent(EventType::Match, party.id, instances[instanceId].id, party.dungeonType);
+
+                if (instanceThreads[instanceId].joinable()) {
+                    instanceThreads[instanceId].join();
+                }
+                instanceThreads[instanceId] = std::thread(runInstance, instanceId, std::move(party), pool.startupCost(startup));
+            }
+            else {
+                // Wait for an instance to become available, a resize or a reload. A
+                // scenario can also bring instances online without freeing one, so
+                // then look again at least every 100ms.
+                std::unique_lock<std::mutex> lock(instancesMutex);
+                auto ready = []() {
+                    return !freedInstances.empty() || shutdown || requestedFleetSize.load() >= 0 ||
+                        std::atomic_load(&pendingConfig) != nullptr;
+                };
+                if (scenarioLoaded) cv.wait_for(lock, std::chrono::milliseconds(100), ready);
+                else cv.wait(lock, ready);
+            }
+        }
+        else {
+            {
+                // Wait up to 100ms for players to arrive or a crashed party to come back
+                std::unique_lock<QueueMutex> lock(queueMutex);
+                queueCv.wait_for(lock, std::chrono::milliseconds(100), []() {
+                    return shutdown || !requeuedParties.empty() ||
+                        (skillWindow <= 0 && tanksAvailable >= 1 && healersAvailable >= 1 && dpsAvailable >= 3);
+                });
+            }
+            if (daemonMode) continue; // a daemon idles until it is told to stop
+
+            // Check if no parties can form
+            if (!canEverFormParty() && !hasRequeuedParty()) {
+                // Check if any instances are still active
+                bool anyActive = false;
+                {
+                    std::lock_guard<std::mutex> lock(instancesMutex);
+                    anyActive = busyInstances > 0;
+                }
+
+                // Only shut down if no active instances and no parties can form
+                if (!anyActive) {
+                    shutdown = true;
+                }
+            }
+        }
+    }
+
+    // Join all instance threads before exiting
+    for (auto& t : instanceThreads) {
+        if (t.joinable()) {
+            t.join();
+        }
+    }
+}
+
+EngineConfig configFromGlobals() {
+    EngineConfig config;
+    config.instances = maxInstances;
+    config.minTime = minTime;
+    config.maxTime = maxTime;
+    config.fairness = fairnessPolicy;
+    config.agingRate = agingRate;
+    config.instancePolicy = instancePolicy;
+    config.distribution = clearTimeDistribution;
+    config.sigma = clearTimeSigma;
+    config.crashProbability = crashProbability;
+    config.meanTimeToFailure = meanTimeToFailure;
+    config.recoveryTime = recoveryTime;
+    config.arrivalRate = arrivalRate;
+    config.version = 1;
+    return config;
+}
+
+std::shared_ptr<const EngineConfig> currentConfig() {
+    return std::atomic_load(&liveConfig);
+}
+
+void publishConfig(const EngineConfig& config) {
+    std::atomic_store(&liveConfig, std::shared_ptr<const EngineConfig>(new EngineConfig(config)));
+}
+
+// Reads the live settings from config.txt over the running values. Unlike the
+// startup read, a bad value rejects the whole file, so a half-edited config never
+// reaches the engine. Other keys are ignored; they only take effect on restart.
+bool parseLiveConfig(std::istream& configFile, EngineConfig& config, std::string& error) {
+    std::string line;
+    while (std::getline(configFile, line)) {
+        std::istringstream iss(line);
+        std::string key;
+        std::string value;
+        iss >> key >> value;
+        if (key.empty()) continue;
+        std::istringstream number(value);
+        bool ok = true;
+        if (key == "max-num-instances") ok = (number >> config.instances) && config.instances > 0 && config.instances <= InstanceTable::capacity;
+        else if (key == "min-time") ok = (number >> config.minTime) && config.minTime > 0;
+        else if (key == "max-time") ok = (number >> config.maxTime) && config.maxTime > 0;
+        else if (key == "aging-rate") ok = (number >> config.agingRate) && config.agingRate >= 0;
+        else if (key == "clear-time-sigma") ok = (number >> config.sigma) && config.sigma > 0 && config.sigma <= 4;
+        else if (key == "crash-probability") ok = (number >> config.crashProbability) && config.crashProbability >= 0 && config.crashProbability <= 1;
+        else if (key == "mean-time-to-failure") ok = (number >> config.meanTimeToFailure) && config.meanTimeToFailure >= 0;
+        else if (key == "recovery-time") ok = (number >> config.recoveryTime) && config.recoveryTime >= 0;
+        else if (key == "arrival-rate") {
+            // 0 picks a rate from the fleet at startup; a reload keeps whatever is running
+            double rate = 0.0;
+            ok = (number >> rate) && rate >= 0;
+            if (rate > 0) config.arrivalRate = rate;
+        }
+        else if (key == "fairness-policy") {
+            ok = value == "legacy" || value == "fifo" || value == "aging";
+            if (ok) config.fairness = parseFairnessPolicy(value);
+        }
+        else if (key == "instance-policy") {
+            ok = value == "lowest-index" || value == "round-robin" || value == "least-utilised" ||
+                value == "most-recently-freed" || value == "power-of-two";
+            if (ok) config.instancePolicy = parseInstancePolicy(value);
+        }
+        else if (key == "clear-time-distribution") {
+            ok = value == "uniform" || value == "lognormal";
+            if (ok) config.distribution = value == "lognormal" ? ClearTimeDistribution::LogNormal : ClearTimeDistribution::Uniform;
+        }
+        if (!ok) {
+            error = "invalid value for " + key;
+            return false;
+        }
+    }
+    if (config.maxTime > 15) config.maxTime = 15; // same cap as at startup
+    if (config.maxTime <= config.minTime) {
+        error = "max-time must be greater than min-time";
+        return false;
+    }
+    return true;
+}
+
+// Parses and validates config.txt, then leaves it for the queue manager to apply
+bool reloadConfig() {
+    std::shared_ptr<const EngineConfig> current = currentConfig();
+    EngineConfig next = *current;
+    std::ifstream configFile(configPath);
+    std::string error = "could not open config.txt";
+    if (!configFile.is_open() || !parseLiveConfig(configFile, next, error)) {
+        std::cerr << "Warning: config.txt reload rejected (" << error << "), keeping the running config." << std::endl;
+        return false;
+    }
+    next.version = current->version + 1;
+    std::atomic_store(&pendingConfig, std::shared_ptr<const EngineConfig>(new EngineConfig(next)));
+    queueCv.notify_all();
+    wakeInstanceWaiters();
+    return true;
+}
+
+// Runs on the queue manager between dispatches, so a party is matched and sent
+// entirely under one config. Queued players are re-ordered for a new fairness
+// policy, the fleet is resized, and the rest is picked up through currentConfig()
+// by every run that starts afterwards; runs already going keep their clear time.
+template <typename Selector>
+void applyConfig(const std::shared_ptr<const EngineConfig>& next) {
+    std::shared_ptr<const EngineConfig> previous = currentConfig();
+    std::ostringstream changes;
+    if (next->fairness != previous->fairness || next->agingRate != previous->agingRate) {
+        reorderRoleQueues(next->fairness, next->agingRate);
+        changes << " fairness " << fairnessPolicyName(next->fairness) << " (aging " << next->agingRate << ")";
+    }
+    if (next->instances != previous->instances) {
+        requestFleetResize(next->instances);
+        changes << " instances " << previous->instances << " -> " << next->instances;
+    }
+    if (next->minTime != previous->minTime || next->maxTime != previous->maxTime) {
+        changes << " clear time " << next->minTime << "-" << next->maxTime << "s";
+    }
+    if (next->distribution != previous->distribution || next->sigma != previous->sigma) {
+        changes << " distribution " << (next->distribution == ClearTimeDistribution::LogNormal ? "lognormal" : "uniform");
+    }
+    if (next->crashProbability != previous->crashProbability || next->meanTimeToFailure != previous->meanTimeToFailure ||
+        next->recoveryTime != previous->recoveryTime) {
+        changes << " failures " << next->crashProbability << "/" << next->meanTimeToFailure << "s/" << next->recoveryTime << "s";
+    }
+    if (next->arrivalRate != previous->arrivalRate) {
+        changes << " arrival rate " << next->arrivalRate << "/s";
+    }
+    if (next->instancePolicy != previous->instancePolicy) {
+        std::cerr << "Warning: instance-policy " << instancePolicyName(next->instancePolicy)
+            << " takes effect on restart; still using " << instancePolicyName(previous->instancePolicy) << "." << std::endl;
+    }
+    // The startup globals are left as read from config.txt, since other threads
+    // read them unlocked; anything that must follow a reload reads currentConfig()
+    std::atomic_store(&liveConfig, next);
+    if (displayMode != DisplayMode::Quiet) {
+        std::string applied = changes.str();
+        std::cout << "\n> Config v" << next->version << " applied:" << (applied.empty() ? " no live changes" : applied) << std::endl;
+    }
+}
+
+// Last write time of config.txt, or -1 if it cannot be read
+long long configModifiedTime() {
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA info;
+    if (!GetFileAttributesExA(configPath, GetFileExInfoStandard, &info)) return -1;
+    return (static_cast<long long>(info.ftLastWriteTime.dwHighDateTime) << 32) | info.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat info;
+    if (stat(configPath, &info) != 0) return -1;
+    return static_cast<long long>(info.st_mtime) * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+}
+
+// Reloads config.txt whenever it changes, until shutdown. On Linux inotify
+// watches the directory, so editors that save by renaming a new file over the
+// old one are caught too; elsewhere, or if inotify is unavailable, the
+// modification time is polled every half second.
+void watchConfig() {
+#ifdef __linux__
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd >= 0 && inotify_add_watch(fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) >= 0) {
+        alignas(inotify_event) char buffer[4096];
+        while (!shutdown) {
+            pollfd ready = { fd, POLLIN, 0 };
+            if (poll(&ready, 1, 100) <= 0) continue;
+            bool touched = false;
+            ssize_t length;
+            while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+                for (char* at = buffer; at < buffer + length;) {
+                    const inotify_event* event = reinterpret_cast<const inotify_event*>(at);
+                    if (event->len > 0 && std::strcmp(event->name, configPath) == 0) touched = true;
+                    at += sizeof(inotify_event) + event->len;
+                }
+            }
+            if (!touched) continue;
+            // Let a burst of writes from one save settle, then read it once
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            while (read(fd, buffer, sizeof(buffer)) > 0) {}
+            reloadConfig();
+        }
+        close(fd);
+        return;
+    }
+    if (fd >= 0) close(fd);
+#endif
+    long long seen = configModifiedTime();
+    while (!shutdown) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        long long modified = configModifiedTime();
+        if (modified == seen) continue;
+        seen = modified;
+        if (modified >= 0) reloadConfig();
+    }
+}
+
+// For state the manager's instance wait checks but that is not set under
+// instancesMutex: passing through the lock before notifying means a manager that
+// saw the old state is already waiting and gets the wakeup
+void wakeInstanceWaiters() {
+    {
+        std::lock_guard<std::mutex> lock(instancesMutex);
+    }
+    cv.notify_all();
+}
+
+// Asks the queue manager to grow or shrink the live fleet; the latest request wins
+void requestFleetResize(int target) {
+    requestedFleetSize = std::max(0, std::min(target, InstanceTable::capacity));
+    queueCv.notify_all();
+    wakeInstanceWaiters();
+}
+
+// Runs on the manager thread between dispatches, with instancesMutex held, so
+// matching carries on around it. Growing brings back draining then retired
+// instances before appending new ones. Shrinking takes the highest indices: idle
+// ones retire at once (the selector skips them later), busy ones finish their
+// party first.
+template <typename Selector>
+void resizeFleet(WarmPool<Selector>& pool, int target) {
+    int inService = 0;
+    for (const auto& instance : instances) {
+        if (!instance.retired && !instance.draining) inService++;
+    }
+    int before = inService;
+    for (int i = 0; i < instances.size() && inService < target; i++) {
+        Instance& instance = instances[i];
+        if (instance.draining) {
+            instance.draining = false;
+            inService++;
+        }
+    }
+    for (int i = 0; i < instances.size() && inService < target; i++) {
+        Instance& instance = instances[i];
+        if (!instance.retired) continue;
+        instance.retired = false;
+        if (!instance.pooled) {
+            pool.release(i, instance);
+            instance.pooled = true;
+        }
+        inService++;
+    }
+    while (inService < target && instances.push_back(Instance(instances.size() + 1))) {
+        int index = instances.size() - 1;
+        pool.release(index, instances[index]);
+        instances[index].pooled = true;
+        inService++;
+    }
+    for (int i = instances.size() - 1; i >= 0 && inService > target; i--) {
+        Instance& instance = instances[i];
+        if (instance.retired || instance.draining) continue;
+        if (instance.active || instance.recovering) instance.draining = true;
+        else instance.retired = true;
+        inService--;
+    }
+    liveStats.instanceCount.store(instances.size(), std::memory_order_relaxed);
+    if (displayMode != DisplayMode::Quiet && inService != before) {
+        std::cout << "\n> Fleet resized from " << before << " to " << inService << " instances" << std::endl;
+    }
+}
+
+void displaySummary() {
+    std::shared_ptr<const EngineConfig> config = currentConfig(); // as last reloaded
+    std::lock_guard<std::mutex> lock(instancesMutex);
+    std::cout << "\n===== Instance Summary =====" << std::endl;
+    for (const auto& instance : instances) {
+        std::cout << "Instance " << instance.id << ":" << (instance.retired ? " (retired)" : "") << std::endl;
+        std::cout << "  Parties served: " << instance.partiesServed << std::endl;
+        std::cout << "  Total time served: " << instance.totalTimeServed.count() << " seconds" << std::endl;
+        if (coldStartTime > 0 || mapLoadTime > 0) {
+            std::cout << "  Cold starts: " << instance.coldStarts << ", map loads: " << instance.mapLoads << std::endl;
+        }
+        if (instance.crashes > 0) {
+            std::cout << "  Crashes: " << instance.crashes << std::endl;
+        }
+    }
+
+    int totalParties = 0;
+    std::chrono::seconds totalTime(0);
+    for (const auto& instance : instances) {
+        totalParties += instance.partiesServed;
+        totalTime += instance.totalTimeServed;
+    }
+
+    std::cout << "\nOverall Summary:" << std::endl;
+    std::cout << "  Total parties served: " << totalParties << std::endl;
+    std::cout << "  Total time served across all instances: " << totalTime.count() << " seconds" << std::endl;
+    std::cout << std::fixed;
+    if (!daemonMode) {
+        // Daemon runs keep only rolling windows, reported separately
+        std::cout << "  Queue wait (" << (skillWindow > 0 ? "skill" : fairnessPolicyName(config->fairness)) << "): max " << std::setprecision(1)
+            << percentile(matchWaits, 1.0) << "s, p50 " << percentile(matchWaits, 0.5)
+            << "s, Jain index " << std::setprecision(3) << jainIndex(matchWaits) << std::endl;
+    }
+    if ((coldStartTime > 0 || mapLoadTime > 0) && daemonMode) {
+        // Daemon dispatches only feed the rolling window, so report its last hour
+        RollingWindow::Summary startup;
+        {
+            std::lock_guard<std::mutex> rollingLock(rollingMutex);
+            startup = rollingStats.startup.summarize(engineNow(), RollingWindow::seconds);
+        }
+        std::cout << "  Instance startup (last engine hour): warm pool " << warmPoolSize << ", mean " << std::setprecision(2)
+            << (startup.count == 0 ? 0.0 : startup.sum / startup.count) << "s, p99 "
+            << startup.p99 << "s per dispatch" << std::endl;
+    }
+    else if (coldStartTime > 0 || mapLoadTime > 0) {
+        double startupTotal = 0.0;
+        for (double wait : startupWaits) startupTotal += wait;
+        std::cout << "  Instance startup: warm pool " << warmPoolSize << ", mean " << std::setprecision(2)
+            << (startupWaits.empty() ? 0.0 : startupTotal / startupWaits.size()) << "s, p99 "
+            << percentile(startupWaits, 0.99) << "s per dispatch" << std::endl;
+    }
+    if (config->crashProbability > 0 || config->meanTimeToFailure > 0) {
+        int totalCrashes = 0;
+        for (const auto& instance : instances) totalCrashes += instance.crashes;
+        std::cout << "  Failures: " << totalCrashes << " crashes, " << std::setprecision(1) << workLost << "s of work lost";
+        if (daemonMode) {
+            // Like startup, daemon recoveries only feed the rolling window
+            RollingWindow::Summary recovery;
+            {
+                std::lock_guard<std::mutex> rollingLock(rollingMutex);
+                recovery = rollingStats.recovery.summarize(engineNow(), RollingWindow::seconds);
+            }
+            if (recovery.count > 0) {
+                std::cout << ", recovery latency (last engine hour) mean " << recovery.sum / recovery.count
+                    << "s, max " << recovery.max << "s";
+            }
+        }
+        else if (!recoveryLatencies.empty()) {
+            double recoveryTotal = 0.0;
+            for (double latency : recoveryLatencies) recoveryTotal += latency;
+            std::cout << ", recovery latency mean " << recoveryTotal / recoveryLatencies.size()
+                << "s, max " << percentile(recoveryLatencies, 1.0) << "s";
+        }
+        std::cout << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+
+    {
+        std::lock_guard<QueueMutex> qLock(queueMutex);
+        if (duplicateJoins > 0) {
+            std::cout << "  Duplicate joins rejected: " << duplicateJoins << std::endl;
+        }
+        long long rateLimited = rejectedRateLimited.load();
+        long long queueFull = rejectedQueueFull.load();
+        if (rateLimited > 0 || queueFull > 0) {
+            std::cout << "  Joins rejected by admission control: " << rateLimited << " over the source rate limit, "
+                << queueFull << " with the queue full" << std::endl;
+        }
+        if (queueLeaves > 0 || missedLeaves > 0) {
+            std::cout << "  Players who left the queue: " << queueLeaves << " (" << missedLeaves << " leaves too late or unknown)" << std::endl;
+        }
+        std::cout << "\nLeftover Players:" << std::endl;
+        std::cout << "  Tanks: " << tanksAvailable << std::endl;
+        std::cout << "  Healers: " << healersAvailable << std::endl;
+        std::cout << "  DPS: " << dpsAvailable << std::endl;
+
+        int maxPossibleParties = std::min({ tanksAvailable, healersAvailable, dpsAvailable / 3 });
+        SkillGroup group;
+        if (maxPossibleParties > 0 && skillWindow > 0 && !findSkillGroup(Clock::now(), true, group)) {
+            std::cout << "  These players are too far apart in rating to share a party," << std::endl;
+            std::cout << "  even at the widest skill window (+/-" << skillMaxWindow << ")." << std::endl;
+        }
+        else if (maxPossibleParties > 0) {
+            std::cout << "  Note: " << maxPossibleParties << " more parties could have been formed," << std::endl;
+            std::cout << "        but there weren't enough instances available." << std::endl;
+        }
+        else {
+            int totalLeftover = tanksAvailable + healersAvailable + dpsAvailable;
+            if (totalLeftover > 0) {
+                std::cout << "  These players couldn't form complete parties due to role imbalance." << std::endl;
+            }
+            else {
+                std::cout << "  No leftover players - all players were assigned to parties." << std::endl;
+            }
+        }
+    }
+
+    std::cout << "===============================" << std::endl;
+}
+
+FairnessPolicy parseFairnessPolicy(const std::string& name) {
+    if (name == "legacy") return FairnessPolicy::Legacy;
+    if (name == "fifo") return FairnessPolicy::StrictFifo;
+    if (name != "aging") {
+        std::cerr << "Warning: Unknown fairness-policy '" << name << "' in config file. Using aging." << std::endl;
+    }
+    return FairnessPolicy::Aging;
+}
+
+const char* fairnessPolicyName(FairnessPolicy policy) {
+    switch (policy) {
+    case FairnessPolicy::Legacy: return "legacy";
+    case FairnessPolicy::StrictFifo: return "fifo";
+    default: return "aging";
+    }
+}
+
+// Returns false, leaving the queues untouched, if the player is already queued or
+// in a party, or admission control turns the join away
+bool enqueuePlayer(const Player& player, int source) {
+    if (admitJoin(source) != QueueResult::Joined) return false;
+    {
+        std::lock_guard<QueueMutex> lock(queueMutex);
+        if (joinLocked(player) != QueueResult::Joined) {
+            refundAdmission(source);
+            return false;
+        }
+        publishRoleDepths();
+    }
+    queueCv.notify_one();
+    recordEvent(EventType::Enqueue, player.id, 0, player.role);
+    return true;
+}
+
+bool leaveQueue(int playerId) {
+    Role role;
+    {
+        std::lock_guard<QueueMutex> lock(queueMutex);
+        if (!leaveLocked(playerId, &role)) return false;
+        publishRoleDepths();
+    }
+    recordEvent(EventType::Leave, playerId, 0, role);
+    return true;
+}
+
+// Applies joins and leaves in order under one queueMutex hold, with one depth
+// publish and one wakeup for the whole batch. A join and a later leave of the same
+// id in one batch both take effect. Admission runs first, outside the lock, and a
+// batch with nothing admitted and no leaves never takes it. Returns how many items
+// were accepted.
+size_t applyQueueBatch(const std::vector<QueueRequest>& batch, std::vector<QueueResult>& results) {
+    results.resize(batch.size());
+    std::vector<Role> leftRoles(eventExporter != nullptr ? batch.size() : 0);
+    size_t accepted = 0;
+    bool joined = false;
+    bool locking = false;
+    for (size_t i = 0; i < batch.size(); i++) {
+        results[i] = batch[i].leave ? QueueResult::Left : admitJoin(batch[i].source);
+        locking = locking || results[i] == QueueResult::Left || results[i] == QueueResult::Joined;
+    }
+    if (locking) {
+        std::lock_guard<QueueMutex> lock(queueMutex);
+        for (size_t i = 0; i < batch.size(); i++) {
+            const QueueRequest& request = batch[i];
+            if (request.leave) {
+                Role role = TANK;
+                results[i] = leaveLocked(request.player.id, &role) ? QueueResult::Left : QueueResult::NotQueued;
+                if (!leftRoles.empty()) leftRoles[i] = role;
+            }
+            else if (results[i] == QueueResult::Joined) {
+                results[i] = joinLocked(request.player);
+                joined = joined || results[i] == QueueResult::Joined;
+                if (results[i] != QueueResult::Joined) refundAdmission(request.source);
+            }
+            if (results[i] == QueueResult::Joined || results[i] == QueueResult::Left) accepted++;
+        }
+        publishRoleDepths();
+    }
+    if (joined) queueCv.notify_one();
+    if (eventExporter != nullptr) {
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (results[i] == QueueResult::Joined) recordEvent(EventType::Enqueue, batch[i].player.id, 0, batch[i].player.role);
+            else if (results[i] == QueueResult::Left) recordEvent(EventType::Leave, batch[i].player.id, 0, leftRoles[i]);
+        }
+    }
+    return accepted;
+}
+
+// Caller holds queueMutex. Rechecks the queue cap exactly, since admitJoin only
+// saw the depths as last published.
+QueueResult joinLocked(const Player& player) {
+    if (maxQueueSize > 0 && tanksAvailable + healersAvailable + dpsAvailable >= maxQueueSize) {
+        rejectedQueueFull.fetch_add(1, std::memory_order_relaxed);
+        return QueueResult::QueueFull;
+    }
+    if (!activePlayers.insert(player.id)) {
+        duplicateJoins++;
+        return QueueResult::Duplicate;
+    }
+    Player queued = player;
+    queued.joinStamp = ++joinStamps[player.role];
+    queuedIds[player.role].insert(player.id, queued.joinStamp);
+    if (skillWindow > 0) skillIndex[player.role].push(queued);
+    else roleQueues[player.role].push(queued);
+    if (player.role == TANK) tanksAvailable++;
+    else if (player.role == HEALER) healersAvailable++;
+    else dpsAvailable++;
+    return QueueResult::Joined;
+}
+
+void initAdmission() {
+    admissionSlots = admissionRate > 0 ? std::max(1, admissionSources) : 0;
+    admissionBuckets.reset(admissionSlots > 0 ? new std::atomic<int64_t>[admissionSlots] : nullptr);
+    for (int i = 0; i < admissionSlots; i++) admissionBuckets[i].store(0);
+}
+
+int64_t admissionClock() {
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - engineStart).count() / timeScale);
+}
+
+// Lock-free gate in front of every join. The queue cap is three relaxed loads of
+// the published depths; the rate limit rejects on a single load and compare, and
+// only an admitted join pays for the compare-and-swap that takes its token. The
+// caller hands the token back with refundAdmission if joinLocked rejects the join.
+QueueResult admitJoin(int source) {
+    if (maxQueueSize > 0) {
+        int queued = liveStats.roleDepth[TANK].load(std::memory_order_relaxed) +
+            liveStats.roleDepth[HEALER].load(std::memory_order_relaxed) + liveStats.roleDepth[DPS].load(std::memory_order_relaxed);
+        if (queued >= maxQueueSize) {
+            rejectedQueueFull.fetch_add(1, std::memory_order_relaxed);
+            return QueueResult::QueueFull;
+        }
+    }
+    if (admissionSlots == 0 || source == ADMISSION_INTERNAL) return QueueResult::Joined;
+    std::atomic<int64_t>& bucket = admissionBuckets[static_cast<unsigned>(source) % admissionSlots];
+    const int64_t interval = static_cast<int64_t>(1e9 / admissionRate);
+    const int64_t tolerance = static_cast<int64_t>((admissionBurst - 1) * interval);
+    int64_t now = admissionClock();
+    int64_t full = bucket.load(std::memory_order_relaxed);
+    while (true) {
+        if (full - now > tolerance) {
+            rejectedRateLimited.fetch_add(1, std::memory_order_relaxed);
+            return QueueResult::RateLimited;
+        }
+        if (bucket.compare_exchange_weak(full, std::max(full, now) + interval, std::memory_order_relaxed)) return QueueResult::Joined;
+    }
+}
+
+// Gives back the token admitJoin took for a join the queue then turned away as
+// full or a duplicate, so a rejected join never counts against its source
+void refundAdmission(int source) {
+    if (admissionSlots == 0 || source == ADMISSION_INTERNAL) return;
+    admissionBuckets[static_cast<unsigned>(source) % admissionSlots].fetch_sub(static_cast<int64_t>(1e9 / admissionRate), std::memory_order_relaxed);
+}
+
+// Engine seconds until the source may join again, 0 if it can now
+double admissionRetryAfter(int source) {
+    if (admissionSlots == 0 || source == ADMISSION_INTERNAL) return 0.0;
+    const int64_t interval = static_cast<int64_t>(1e9 / admissionRate);
+    int64_t wait = admissionBuckets[static_cast<unsigned>(source) % admissionSlots].load(std::memory_order_relaxed) -
+        static_cast<int64_t>((admissionBurst - 1) * interval) - admissionClock();
+    return wait > 0 ? wait / 1e9 : 0.0;
+}
+
+// Fill of the queue cap from 0 to 1, for callers to slow down before joins bounce;
+// always 0 without a cap
+double queuePressure() {
+    if (maxQueueSize <= 0) return 0.0;
+    int queued = liveStats.roleDepth[TANK].load(std::memory_order_relaxed) +
+        liveStats.roleDepth[HEALER].load(std::memory_order_relaxed) + liveStats.roleDepth[DPS].load(std::memory_order_relaxed);
+    return std::min(1.0, static_cast<double>(queued) / maxQueueSize);
+}
+
+// Caller holds queueMutex. Rebuilds the role's queue once left-behind entries
+// outnumber the waiting players, so heavy churn cannot grow it without bound.
+bool leaveLocked(int playerId, Role* role) {
+    for (int r = 0; r < ROLE_COUNT; r++) {
+        if (!queuedIds[r].erase(playerId)) continue;
+        activePlayers.erase(playerId);
+        *role = static_cast<Role>(r);
+        int& available = r == TANK ? tanksAvailable : r == HEALER ? healersAvailable : dpsAvailable;
+        available--;
+        queueLeaves++;
+        if (roleQueues[r].size() > 2 * static_cast<size_t>(available) + 1024) {
+            compactRoleQueue(*role, roleQueues[r].policy, roleQueues[r].agingRate);
+        }
+        if (skillIndex[r].size() > 2 * static_cast<size_t>(available) + 1024) compactSkillIndex(*role);
+        return true;
+    }
+    missedLeaves++;
+    return false;
+}
+
+// Caller holds queueMutex and has checked the role's counter. Skips entries left
+// behind by leaves: their id is no longer in queuedIds, or holds the stamp of a
+// later join after the player left and joined again.
+Player popQueued(Role role) {
+    while (true) {
+        Player player = roleQueues[role].pop();
+        if (queuedIds[role].erase(player.id, player.joinStamp)) return player;
+    }
+}
+
+// Caller holds queueMutex. Drops left-behind entries, keeping the current join's
+// entry of each waiting id, and re-orders the rest if the policy changed.
+void compactRoleQueue(Role role, FairnessPolicy policy, double rate) {
+    RoleQueue& queue = roleQueues[role];
+    auto waitingPlayer = [role](const Player& player) {
+        return queuedIds[role].contains(player.id, player.joinStamp);
+    };
+    if (policy == queue.policy && rate == queue.agingRate) {
+        queue.retain(waitingPlayer);
+        return;
+    }
+    std::vector<Player> waiting;
+    waiting.reserve(queuedIds[role].size());
+    while (queue.size() > 0) {
+        Player player = queue.pop();
+        if (waitingPlayer(player)) waiting.push_back(player);
+    }
+    queue.policy = policy;
+    queue.agingRate = rate;
+    queue.pushBulk(waiting);
+}
+
+// Queue manager only, without queueMutex. Re-orders every role queue for a new
+// policy without holding the lock for the O(n log n) rebuild: the queues are
+// copied under the lock, rebuilt outside it, then joins that landed meanwhile
+// (stamps past the copy's) are added and the rebuilt queues swapped in. Nothing
+// else pops, since only the manager forms parties; entries left by leaves
+// meanwhile are skipped when popped, as usual.
+void reorderRoleQueues(FairnessPolicy policy, double rate) {
+    RoleQueue rebuilt[ROLE_COUNT];
+    uint32_t copiedStamp[ROLE_COUNT];
+    {
+        std::lock_guard<QueueMutex> lock(queueMutex);
+        for (int role = 0; role < ROLE_COUNT; role++) {
+            rebuilt[role] = roleQueues[role];
+            copiedStamp[role] = joinStamps[role];
+        }
+    }
+    for (auto& queue : rebuilt) {
+        std::vector<Player> waiting;
+        waiting.reserve(queue.size());
+        while (queue.size() > 0) waiting.push_back(queue.pop());
+        queue.policy = policy;
+        queue.agingRate = rate;
+        queue.pushBulk(waiting);
+    }
+    std::lock_guard<QueueMutex> lock(queueMutex);
+    for (int role = 0; role < ROLE_COUNT; role++) {
+        std::vector<Player> arrived;
+        auto late = [&](const Player& player) {
+            if (static_cast<int32_t>(player.joinStamp - copiedStamp[role]) > 0) arrived.push_back(player);
+        };
+        for (const auto& entry : roleQueues[role].heap) late(entry.second);
+        for (const auto& player : roleQueues[role].fifo) late(player);
+        rebuilt[role].pushBulk(arrived);
+        std::swap(roleQueues[role], rebuilt[role]);
+    }
+}
+
+int log2Bucket(double seconds) {
+    uint64_t ms = seconds > 0 ? static_cast<uint64_t>(seconds * 1000) : 0;
+    int bucket = 0;
+    while (ms > 1 && bucket < 31) {
+        ms >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+double log2BucketUpper(int bucket) {
+    return (1ULL << (bucket + 1)) / 1000.0;
+}
+
+// Upper edge of the log2 bucket holding the p-th sample, in seconds
+double bucketPercentile(const uint64_t* counts, double p) {
+    uint64_t total = 0;
+    for (int b = 0; b < 32; b++) total += counts[b];
+    if (total == 0) return 0.0;
+    uint64_t rank = static_cast<uint64_t>(p * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < 32; b++) {
+        seen += counts[b];
+        if (seen >= rank) return log2BucketUpper(b);
+    }
+    return log2BucketUpper(31);
+}
+
+double engineSeconds(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double>(to - from).count() / timeScale;
+}
+
+long long engineNow() {
+    return static_cast<long long>(engineSeconds(engineStart, Clock::now()));
+}
+
+void sleepEngineSeconds(double seconds) {
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds * timeScale));
+}
+
+// Poisson joins at arrivalRate per engine second with roles in the given ratio,
+// until shutdown. With a scenario, candidates come at its peak rate and each is
+// kept with probability rate(now) / peak, taking its role from the phase mix.
+// Like a lobby gateway, it gathers the joins arriving within joinBatchWindow real
+// seconds (plus leaves of recent joiners, at leaveFraction) and hands them over in
+// one applyQueueBatch when the window closes. Runs until arrivalsStop, then hands
+// over the window still open.
+void generateArrivals(int tankWeight, int healerWeight, int dpsWeight, int firstPlayerId) {
+    std::mt19937 gen(static_cast<uint32_t>(rngSeed >> 32) ^ 0xA5A5A5A5u);
+    double peakRate = scenarioLoaded ? scenario.peakRate() / 60.0 : arrivalRate;
+    if (peakRate <= 0) return;
+    std::exponential_distribution<> gaps(peakRate);
+    uint64_t configVersion = currentConfig()->version;
+    std::uniform_real_distribution<> unit(0.0, 1.0);
+    std::discrete_distribution<> rolePick({ static_cast<double>(tankWeight), static_cast<double>(healerWeight),
+        static_cast<double>(dpsWeight) });
+    std::uniform_int_distribution<> recentJoiner(1, 64);
+    std::uniform_int_distribution<> sourcePick(0, admissionSources - 1);
+    int nextId = firstPlayerId;
+    Clock::time_point next = Clock::now();
+    Clock::time_point windowEnd = next;
+    const Clock::duration window = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(joinBatchWindow));
+    std::vector<QueueRequest> batch;
+    std::vector<QueueResult> results;
+    // Sleep in short steps so a stop is noticed promptly even at low arrival rates
+    auto sleepUntil = [](Clock::time_point until) {
+        while (!shutdown && !arrivalsStop && Clock::now() < until) {
+            std::this_thread::sleep_until(std::min(until, Clock::now() + std::chrono::milliseconds(100)));
+        }
+    };
+    auto handOver = [&batch, &results]() {
+        applyQueueBatch(batch, results);
+        std::lock_guard<std::mutex> lock(rollingMutex);
+        long long now = engineNow();
+        for (size_t i = 0; i < batch.size(); i++) {
+            if (results[i] == QueueResult::Joined) hourlyReport.join(now, batch[i].player.role);
+        }
+        batch.clear();
+    };
+    while (!shutdown && !arrivalsStop) {
+        std::shared_ptr<const EngineConfig> config = currentConfig();
+        if (!scenarioLoaded && config->version != configVersion) {
+            configVersion = config->version;
+            if (config->arrivalRate > 0) gaps = std::exponential_distribution<>(config->arrivalRate);
+        }
+        next += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(gaps(gen) * timeScale));
+        if (next > windowEnd) {
+            sleepUntil(windowEnd);
+            if (!batch.empty()) handOver();
+            sleepUntil(next);
+            windowEnd = next + window;
+        }
+        if (shutdown || arrivalsStop) break;
+        Role role;
+        if (scenarioLoaded) {
+            int64_t nowMs = static_cast<int64_t>(engineSeconds(engineStart, next) * 1000.0);
+            const ScenarioPhase* phase = scenario.phaseAt(nowMs);
+            if (phase == nullptr || unit(gen) * peakRate * 60.0 >= scenario.rateAt(nowMs)) continue;
+            role = scenarioRole(*phase, unit(gen));
+        }
+        else {
+            role = static_cast<Role>(rolePick(gen));
+        }
+        batch.push_back(QueueRequest{ Player(nextId, role, next), false, sourcePick(gen) });
+        batch.back().player.rating = drawRating(nextId++);
+        if (leaveFraction > 0 && unit(gen) < leaveFraction) {
+            int leaver = std::max(firstPlayerId, nextId - recentJoiner(gen));
+            batch.push_back(QueueRequest{ Player(leaver, role, next), true });
+        }
+    }
+    if (!batch.empty()) handOver();
+}
+
+std::string renderRollingStats() {
+    const int windows[] = { 60, 300, 3600 };
+    const char* windowNames[] = { "1 min", "5 min", "1 h" };
+    long long now = engineNow();
+    std::ostringstream out;
+    out << "\n===== Rolling Stats (engine time " << now << "s) =====\n";
+    out << std::left << std::setw(8) << "window" << std::right << std::setw(10) << "parties"
+        << std::setw(12) << "parties/min" << std::setw(10) << "wait p50" << std::setw(10) << "wait p99"
+        << std::setw(10) << "wait max" << std::setw(9) << "crashes" << "\n";
+    {
+        std::lock_guard<std::mutex> lock(rollingMutex);
+        for (int w = 0; w < 3; w++) {
+            RollingWindow::Summary parties = rollingStats.completions.summarize(now, windows[w]);
+            RollingWindow::Summary waits = rollingStats.queueWait.summarize(now, windows[w]);
+            RollingWindow::Summary crashes = rollingStats.crashes.summarize(now, windows[w]);
+            int span = static_cast<int>(std::min<long long>(windows[w], now + 1));
+            out << std::left << std::setw(8) << windowNames[w] << std::right << std::setw(10) << parties.count
+                << std::fixed << std::setprecision(1) << std::setw(12) << parties.count * 60.0 / span
+                << std::setprecision(2) << std::setw(10) << waits.p50 << std::setw(10) << waits.p99
+                << std::setw(10) << waits.max << std::setw(9) << crashes.count << "\n";
+        }
+    }
+    out << "Queue depth: tanks " << liveStats.roleDepth[TANK].load(std::memory_order_relaxed)
+        << ", healers " << liveStats.roleDepth[HEALER].load(std::memory_order_relaxed)
+        << ", dps " << liveStats.roleDepth[DPS].load(std::memory_order_relaxed) << "\n";
+    if (admissionSlots > 0 || maxQueueSize > 0) {
+        out << "Joins rejected: " << rejectedRateLimited.load(std::memory_order_relaxed) << " rate-limited, "
+            << rejectedQueueFull.load(std::memory_order_relaxed) << " queue full (pressure "
+            << std::fixed << std::setprecision(2) << queuePressure() << ")\n";
+    }
+    out << "Completed since start: " << liveStats.completions.load(std::memory_order_relaxed)
+        << ", RSS " << currentRssKb() << " KB\n";
+    out << "===============================\n";
+    return out.str();
+}
+
+// Renders into the buffer the signal handler is not pointing at, then flips it
+void publishStatsSnapshot() {
+    std::string text = renderRollingStats();
+    int next = 1 - statsSnapshotIndex.load();
+    size_t length = std::min(text.size(), sizeof(statsSnapshot[next]));
+    std::copy(text.begin(), text.begin() + length, statsSnapshot[next]);
+    statsSnapshotLength[next] = length;
+    statsSnapshotIndex.store(next);
+}
+
+void handleStopSignal(int) {
+    stopRequested = 1;
+}
+
+void handleStatsSignal(int) {
+#ifndef _WIN32
+    int index = statsSnapshotIndex.load();
+    ssize_t ignored = write(STDOUT_FILENO, statsSnapshot[index], statsSnapshotLength[index]);
+    (void)ignored;
+#endif
+}
+
+long currentRssKb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return static_cast<long>(counters.WorkingSetSize / 1024);
+#else
+    std::ifstream statm("/proc/self/statm");
+    long pages = 0;
+    long resident = 0;
+    if (!(statm >> pages >> resident)) return 0;
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#endif
+}
+
+// Parses the CSV lines that start in [begin, end) as id,roles,timestamp,bracket where
+// roles is any of T, H and D (e.g. "TD"). SSE2 finds every ',' and '\n' 16 bytes at a
+// time and the fields between them are parsed with short scalar loops. Lines that
+// do not have four fields, name no role or carry an id past INT32_MAX are skipped
+// and counted; returns the number skipped.
+size_t parseJoinCsv(const char* data, size_t begin, size_t end, size_t fileSize, std::vector<JoinRecord>& out) {
+    size_t skipped = 0;
+    JoinRecord record = JoinRecord();
+    int field = 0;
+    bool valid = true;
+    size_t fieldStart = begin;
+
+    auto endField = [&](size_t delimiter) {
+        const char* p = data + fieldStart;
+        const char* e = data + delimiter;
+        if (field == 1) {
+            uint8_t flags = 0;
+            for (; p < e; p++) {
+                char c = *p | 0x20; // lower case
+                if (c == 't') flags |= ROLE_FLAG_TANK;
+                else if (c == 'h') flags |= ROLE_FLAG_HEALER;
+                else if (c == 'd') flags |= ROLE_FLAG_DPS;
+            }
+            record.roleFlags = flags;
+            if (flags == 0) valid = false;
+        }
+        else {
+            int64_t value = 0;
+            bool digits = false;
+            for (; p < e && *p >= '0' && *p <= '9'; p++) {
+                value = value * 10 + (*p - '0');
+                digits = true;
+            }
+            if (!digits) valid = false;
+            if (field == 0 && value > INT32_MAX) valid = false; // ids are ints, and -1 is PlayerIdIndex's empty key
+            if (field == 0) record.id = static_cast<uint32_t>(value);
+            else if (field == 2) record.timestamp = value;
+            else if (field == 3) record.bracket = static_cast<uint8_t>(std::min<int64_t>(value, 255));
+        }
+        field++;
+        fieldStart = delimiter + 1;
+    };
+    auto endLine = [&](size_t delimiter) {
+        bool blank = field == 0 && (delimiter == fieldStart || (delimiter == fieldStart + 1 && data[fieldStart] == '\r'));
+        if (!blank) {
+            if (field == 3) endField(delimiter);
+            else valid = false;
+            if (valid) out.push_back(record);
+            else skipped++;
+        }
+        record = JoinRecord();
+        field = 0;
+        valid = true;
+        fieldStart = delimiter + 1;
+    };
+
+    size_t pos = begin;
+#ifdef LFG_HAVE_SSE2
+    const __m128i comma = _mm_set1_epi8(',');
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; pos + 16 <= end && pos + 16 <= fileSize; pos += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        int commas = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, comma));
+        int newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline));
+        int delimiters = commas | newlines;
+        while (delimiters) {
+            int bit = 0;
+            while (!(delimiters & (1 << bit))) bit++;
+            if (newlines & (1 << bit)) endLine(pos + bit);
+            else if (field < 3) endField(pos + bit);
+            else valid = false; // too many fields
+            delimiters &= delimiters - 1;
+        }
+    }
+#endif
+    for (; pos < end; pos++) {
+        if (data[pos] == '\n') endLine(pos);
+        else if (data[pos] == ',') {
+            if (field < 3) endField(pos);
+            else valid = false;
+        }
+    }
+    // A final line without a trailing newline
+    if (fieldStart < end) endLine(end);
+    return skipped;
+}
+
+size_t parseJoinBinary(const char* data, size_t first, size_t last, std::vector<JoinRecord>& out) {
+    size_t skipped = 0;
+    const unsigned char* base = reinterpret_cast<const unsigned char*>(data) + sizeof(joinFileMagic) + 8;
+    for (size_t i = first; i < last; i++) {
+        const unsigned char* r = base + i * joinRecordSize;
+        JoinRecord record;
+        record.id = r[0] | (r[1] << 8) | (r[2] << 16) | (static_cast<uint32_t>(r[3]) << 24);
+        record.roleFlags = r[4] & (ROLE_FLAG_TANK | ROLE_FLAG_HEALER | ROLE_FLAG_DPS);
+        record.bracket = r[5];
+        uint64_t timestamp = 0;
+        for (int b = 7; b >= 0; b--) timestamp = (timestamp << 8) | r[8 + b];
+        record.timestamp = static_cast<int64_t>(timestamp);
+        if (record.roleFlags == 0 || record.id > static_cast<uint32_t>(INT32_MAX)) {
+            skipped++;
+            continue;
+        }
+        out.push_back(record);
+    }
+    return skipped;
+}
+
+// Memory-maps a CSV or binary join file, parses it on every hardware thread and
+// bulk-loads the role queues. Multi-role players wait in whichever of their roles
+// is scarcest, judged by the file's single-role players per party slot (ties go
+// tank, healer, DPS), and keep the rest in roleFlags.
+bool ingestJoinFile(const std::string& path) {
+    Clock::time_point start = Clock::now();
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Error: Could not map join file " << path << std::endl;
+        return false;
+    }
+
+    bool binary = file.size >= sizeof(joinFileMagic) + 8 &&
+        std::equal(joinFileMagic, joinFileMagic + sizeof(joinFileMagic), file.data);
+    int threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // Work out each thread's slice: record ranges for binary, newline-aligned byte ranges for CSV
+    std::vector<size_t> bounds;
+    if (binary) {
+        size_t records = (file.size - sizeof(joinFileMagic) - 8) / joinRecordSize;
+        for (int i = 0; i <= threads; i++) bounds.push_back(records * i / threads);
+    }
+    else {
+        size_t dataStart = 0;
+        // Skip a header line that does not start with a digit
+        if (file.size > 0 && !(file.data[0] >= '0' && file.data[0] <= '9')) {
+            const char* newline = static_cast<const char*>(memchr(file.data, '\n', file.size));
+            dataStart = newline ? newline - file.data + 1 : file.size;
+        }
+        bounds.push_back(dataStart);
+        for (int i = 1; i < threads; i++) {
+            size_t cut = std::max(bounds.back(), dataStart + (file.size - dataStart) * i / threads);
+            const char* newline = cut < file.size ? static_cast<const char*>(memchr(file.data + cut, '\n', file.size - cut)) : nullptr;
+            bounds.push_back(newline ? newline - file.data + 1 : file.size);
+        }
+        bounds.push_back(file.size);
+    }
+
+    std::vector<std::vector<JoinRecord>> parsed(threads);
+    std::vector<size_t> skipped(threads, 0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(std::thread([&, i]() {
+            if (binary) {
+                parsed[i].reserve(bounds[i + 1] - bounds[i]);
+                skipped[i] = parseJoinBinary(file.data, bounds[i], bounds[i + 1], parsed[i]);
+            }
+            else {
+                parsed[i].reserve((bounds[i + 1] - bounds[i]) / 24);
+                skipped[i] = parseJoinCsv(file.data, bounds[i], bounds[i + 1], file.size, parsed[i]);
+            }
+        }));
+    }
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+    Clock::time_point parsedAt = Clock::now();
+
+    int64_t newest = INT64_MIN;
+    size_t totalSkipped = 0;
+    const uint8_t roleFlag[ROLE_COUNT] = { ROLE_FLAG_TANK, ROLE_FLAG_HEALER, ROLE_FLAG_DPS };
+    size_t singleRole[ROLE_COUNT] = {};
+    for (int i = 0; i < threads; i++) {
+        for (const auto& record : parsed[i]) {
+            newest = std::max(newest, record.timestamp);
+            for (int role = 0; role < ROLE_COUNT; role++) {
+                if (record.roleFlags == roleFlag[role]) singleRole[role]++;
+            }
+        }
+        totalSkipped += skipped[i];
+    }
+    // Roles from scarcest to most plentiful, against a party's 1/1/3 slots
+    const double slots[ROLE_COUNT] = { 1.0, 1.0, 3.0 };
+    Role scarcity[ROLE_COUNT] = { TANK, HEALER, DPS };
+    std::stable_sort(scarcity, scarcity + ROLE_COUNT, [&](Role a, Role b) {
+        return singleRole[a] / slots[a] < singleRole[b] / slots[b];
+    });
+
+    // Turn records into players per thread and role, then load each role queue on its own thread
+    Clock::time_point now = Clock::now();
+    std::vector<std::vector<Player>> byRole[ROLE_COUNT];
+    for (auto& role : byRole) role.resize(threads);
+    std::vector<uint32_t> maxIds(threads, 0);
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(std::thread([&, i]() {
+            for (const auto& record : parsed[i]) {
+                Role role = scarcity[ROLE_COUNT - 1];
+                for (int r = ROLE_COUNT - 1; r >= 0; r--) {
+                    if (record.roleFlags & roleFlag[scarcity[r]]) role = scarcity[r];
+                }
+                Player player(static_cast<int>(record.id), role,
+                    now - std::chrono::duration_cast<Clock::duration>(std::chrono::seconds(newest - record.timestamp)));
+                player.roleFlags = record.roleFlags;
+                player.bracket = record.bracket;
+                player.rating = static_cast<uint16_t>(std::min(3999, 100 + 200 * record.bracket)); // brackets are 200-point tiers
+                byRole[role][i].push_back(player);
+                maxIds[i] = std::max(maxIds[i], record.id);
+            }
+            std::vector<JoinRecord>().swap(parsed[i]);
+        }));
+    }
+    for (auto& worker : workers) worker.join();
+    workers.clear();
+
+    // Drop ids that are already active or repeat within the file. The index is not
+    // thread-safe, so this pass runs alone before the queues are loaded.
+    size_t duplicates = 0;
+    {
+        std::lock_guard<QueueMutex> lock(queueMutex);
+        size_t total = 0;
+        for (const auto& role : byRole) {
+            for (const auto& part : role) total += part.size();
+        }
+        activePlayers.reserve(activePlayers.size() + total);
+        for (auto& role : byRole) {
+            for (auto& part : role) {
+                auto kept = std::remove_if(part.begin(), part.end(), [](const Player& player) {
+                    return !activePlayers.insert(player.id);
+                });
+                duplicates += part.end() - kept;
+                part.erase(kept, part.end());
+            }
+        }
+        duplicateJoins += duplicates;
+    }
+
+    size_t counts[ROLE_COUNT];
+    for (int role = 0; role < ROLE_COUNT; role++) {
+        workers.push_back(std::thread([&, role]() {
+            std::vector<Player> players;
+            size_t total = 0;
+            for (const auto& part : byRole[role]) total += part.size();
+            players.reserve(total);
+            for (auto& part : byRole[role]) {
+                players.insert(players.end(), part.begin(), part.end());
+                std::vector<Player>().swap(part);
+            }
+            counts[role] = players.size();
+            if (eventExporter != nullptr) {
+                // Same Enqueue events as every other join path, recorded in one batch
+                std::vector<EngineEvent> events(players.size());
+                int64_t timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - engineStart).count();
+                for (size_t i = 0; i < players.size(); i++) {
+                    events[i].timeNs = timeNs;
+                    events[i].type = EventType::Enqueue;
+                    events[i].subject = players[i].id;
+                    events[i].instance = 0;
+                    events[i].value = role;
+                }
+                eventExporter->recordAll(events);
+            }
+            queuedIds[role].reserve(queuedIds[role].size() + players.size());
+            for (auto& player : players) {
+                player.joinStamp = ++joinStamps[role];
+                queuedIds[role].insert(player.id, player.joinStamp);
+            }
+            if (skillWindow > 0) {
+                for (const auto& player : players) skillIndex[role].push(player);
+            }
+            else {
+                roleQueues[role].pushBulk(players);
+            }
+        }));
+    }
+    for (auto& worker : workers) worker.join();
+
+    {
+        std::lock_guard<QueueMutex> lock(queueMutex);
+        tanksAvailable += static_cast<int>(counts[TANK]);
+        healersAvailable += static_cast<int>(counts[HEALER]);
+        dpsAvailable += static_cast<int>(counts[DPS]);
+        publishRoleDepths();
+    }
+    for (uint32_t id : maxIds) lastIngestedId = std::max(lastIngestedId, static_cast<int>(id));
+
+    double parseSeconds = std::chrono::duration<double>(parsedAt - start).count();
+    double totalSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    size_t loaded = counts[TANK] + counts[HEALER] + counts[DPS];
+    std::cout << "Loaded " << loaded << " players from " << path << (binary ? " (binary)" : " (csv)")
+        << " on " << threads << " threads: " << counts[TANK] << " tanks, " << counts[HEALER] << " healers, "
+        << counts[DPS] << " dps" << std::endl;
+    std::cout << "  parse " << std::fixed << std::setprecision(3) << parseSeconds << "s, total " << totalSeconds
+        << "s (" << std::setprecision(1) << (totalSeconds > 0 ? loaded / totalSeconds / 1e6 : 0.0) << "M records/s)";
+    std::cout.unsetf(std::ios::fixed);
+    if (totalSkipped > 0) std::cout << ", " << totalSkipped << " malformed records skipped";
+    if (duplicates > 0) std::cout << ", " << duplicates << " duplicate ids skipped";
+    std::cout << std::endl;
+    return true;
+}
+
+// Synthetic join file for ingestion runs: 1:1:3 roles with one player in ten
+// flexible, timestamps over the last hour, brackets 0-9. Binary if path ends in .bin.
+void generateJoinFile(const std::string& path, long long count) {
+    bool binary = path.size() >= 4 && path.compare(path.size() - 4, 4, ".bin") == 0;
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error: Could not write " << path << std::endl;
+        return;
+    }
+    std::mt19937 gen(58);
+    std::discrete_distribution<> rolePick({ 1, 1, 3 });
+    std::bernoulli_distribution flexible(0.1);
+    std::uniform_int_distribution<> offset(0, 3599);
+    std::uniform_int_distribution<> bracket(0, 9);
+    const int64_t base = 1700000000;
+    const uint8_t flags[] = { ROLE_FLAG_TANK, ROLE_FLAG_HEALER, ROLE_FLAG_DPS };
+    const char* letters[] = { "T", "H", "D" };
+
+    std::string buffer;
+    buffer.reserve(1 << 20);
+    if (binary) {
+        buffer.append(joinFileMagic, sizeof(joinFileMagic));
+        for (int b = 0; b < 8; b++) buffer.push_back(static_cast<char>(static_cast<uint64_t>(count) >> (8 * b)));
+    }
+    else {
+        buffer += "id,roles,timestamp,bracket\n";
+    }
+    for (long long i = 1; i <= count; i++) {
+        int role = rolePick(gen);
+        bool flex = flexible(gen);
+        int64_t timestamp = base + offset(gen);
+        int playerBracket = bracket(gen);
+        if (binary) {
+            uint32_t id = static_cast<uint32_t>(i);
+            char record[joinRecordSize] = {};
+            for (int b = 0; b < 4; b++) record[b] = static_cast<char>(id >> (8 * b));
+            record[4] = static_cast<char>(flags[role] | (flex ? ROLE_FLAG_DPS : 0));
+            record[5] = static_cast<char>(playerBracket);
+            for (int b = 0; b < 8; b++) record[8 + b] = static_cast<char>(static_cast<uint64_t>(timestamp) >> (8 * b));
+            buffer.append(record, joinRecordSize);
+        }
+        else {
+            buffer += std::to_string(i);
+            buffer += ',';
+            buffer += letters[role];
+            if (flex && role != DPS) buffer += 'D';
+            buffer += ',';
+            buffer += std::to_string(timestamp);
+            buffer += ',';
+            buffer += std::to_string(playerBracket);
+            buffer += '\n';
+        }
+        if (buffer.size() >= (1 << 20)) {
+            out.write(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), buffer.size());
+    std::cout << "Wrote " << count << " join records to " << path << std::endl;
+}
+
+// The canFormParty/formParty/maxPossibleParties pattern on bare role counters:
+// every thread alternates between a batch of joins and trying to form a party.
+// Returns millions of operations per second.
+template <typename Lock>
+double benchmarkLockedCounters(int threads, int opsPerThread) {
+    Lock lock;
+    int tanks = 0;
+    int healers = 0;
+    int dps = 0;
+    long long formed = 0;
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&]() {
+            while (!go.load()) std::this_thread::yield();
+            for (int i = 0; i < opsPerThread; i++) {
+                std::lock_guard<Lock> guard(lock);
+                if (i % 2 == 0) {
+                    tanks += 1;
+                    healers += 1;
+                    dps += 3;
+                }
+                else if (std::min({ tanks, healers, dps / 3 }) > 0) {
+                    tanks -= 1;
+                    healers -= 1;
+                    dps -= 3;
+                    formed++;
+                }
+            }
+        }));
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    go = true;
+    for (auto& worker : workers) worker.join();
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    return static_cast<double>(threads) * opsPerThread / elapsed.count() / 1e6;
+}
+
+// Same workload with the three counters packed 21 bits each into one 64-bit word
+// and updated by CAS, no lock at all
+double benchmarkLockFreeCounters(int threads, int opsPerThread) {
+    const uint64_t tank = 1ULL;
+    const uint64_t healer = 1ULL << 21;
+    const uint64_t dpsUnit = 1ULL << 42;
+    const uint64_t mask = (1ULL << 21) - 1;
+    const uint64_t partyCost = tank + healer + 3 * dpsUnit;
+    std::atomic<uint64_t> counters(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&]() {
+            while (!go.load()) std::this_thread::yield();
+            for (int i = 0; i < opsPerThread; i++) {
+                if (i % 2 == 0) {
+                    counters.fetch_add(partyCost, std::memory_order_acq_rel);
+                    continue;
+                }
+                uint64_t current = counters.load(std::memory_order_relaxed);
+                while ((current & mask) >= 1 && ((current >> 21) & mask) >= 1 && ((current >> 42) & mask) >= 3) {
+                    if (counters.compare_exchange_weak(current, current - partyCost, std::memory_order_acq_rel)) break;
+                }
+            }
+        }));
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    go = true;
+    for (auto& worker : workers) worker.join();
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    return static_cast<double>(threads) * opsPerThread / elapsed.count() / 1e6;
+}
+
+void benchmarkLocks() {
+    const int threadCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+    const int totalOps = 4000000;
+    std::cout << "\n===== Queue Lock Benchmark (" << std::thread::hardware_concurrency() << " hardware threads) =====" << std::endl;
+    std::cout << std::right << std::setw(8) << "threads" << std::setw(14) << "std::mutex"
+        << std::setw(14) << "hybrid" << std::setw(14) << "lock-free" << std::endl;
+    for (int threads : threadCounts) {
+        int opsPerThread = totalOps / threads;
+        std::cout << std::fixed << std::setprecision(2) << std::setw(8) << threads
+            << std::setw(14) << benchmarkLockedCounters<std::mutex>(threads, opsPerThread)
+            << std::setw(14) << benchmarkLockedCounters<HybridMutex>(threads, opsPerThread)
+            << std::setw(14) << benchmarkLockFreeCounters(threads, opsPerThread) << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << "(millions of join/form operations per second)" << std::endl;
+    std::cout << "===============================" << std::endl;
+}
+
+// Gateway threads each join a window of `batchSize` fresh players and then have
+// them all leave, either one call per player (batchSize 1: enqueuePlayer and
+// leaveQueue) or one applyQueueBatch per window. Returns millions of items per second.
+double benchmarkQueueBatch(int threads, int batchSize, int itemsPerThread) {
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&, t]() {
+            std::vector<QueueRequest> batch;
+            std::vector<QueueResult> results;
+            int firstId = 1 + t * itemsPerThread;
+            while (!go.load()) std::this_thread::yield();
+            for (int base = 0; base < itemsPerThread; base += 2 * batchSize) {
+                int count = std::min(batchSize, (itemsPerThread - base) / 2);
+                if (count <= 0) break;
+                int id = firstId + base;
+                if (batchSize == 1) {
+                    enqueuePlayer(Player(id, static_cast<Role>(id % ROLE_COUNT), Clock::now()));
+                    leaveQueue(id);
+                    continue;
+                }
+                Clock::time_point now = Clock::now();
+                batch.clear();
+                for (int i = 0; i < count; i++) batch.push_back(QueueRequest{ Player(id + i, static_cast<Role>((id + i) % ROLE_COUNT), now), false });
+                applyQueueBatch(batch, results);
+                for (auto& request : batch) request.leave = true;
+                applyQueueBatch(batch, results);
+            }
+        }));
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    go = true;
+    for (auto& worker : workers) worker.join();
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    return static_cast<double>(threads) * itemsPerThread / elapsed.count() / 1e6;
+}
+
+void benchmarkBatching() {
+    const int threadCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+    const int batchSizes[] = { 1, 16, 256 };
+    const int totalItems = 4000000;
+    std::cout << "\n===== Join/Leave Batching Benchmark (" << std::thread::hardware_concurrency() << " hardware threads, "
+        << (std::is_same<QueueMutex, std::mutex>::value ? "std::mutex" : "hybrid") << " queue lock) =====" << std::endl;
+    std::cout << std::right << std::setw(8) << "threads";
+    for (int batchSize : batchSizes) std::cout << std::setw(14) << (batchSize == 1 ? std::string("per item") : "batch " + std::to_string(batchSize));
+    std::cout << std::endl;
+    for (int threads : threadCounts) {
+        std::cout << std::fixed << std::setprecision(2) << std::setw(8) << threads;
+        for (int batchSize : batchSizes) std::cout << std::setw(14) << benchmarkQueueBatch(threads, batchSize, totalItems / threads);
+        std::cout << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::lock_guard<QueueMutex> lock(queueMutex);
+    std::cout << "(millions of joins+leaves per second; " << queueLeaves << " leaves applied, " << tanksAvailable + healersAvailable + dpsAvailable
+        << " players left queued)" << std::endl;
+    std::cout << "===============================" << std::endl;
+}
+
+// Empties the live queues between benchmark runs
+void resetQueuesForBenchmark() {
+    std::lock_guard<QueueMutex> lock(queueMutex);
+    for (int role = 0; role < ROLE_COUNT; role++) {
+        roleQueues[role].clear();
+        skillIndex[role].clear();
+        skillIndexEpoch++;
+        queuedIds[role] = PlayerIdIndex(true);
+    }
+    activePlayers = PlayerIdIndex();
+    tanksAvailable = 0;
+    healersAvailable = 0;
+    dpsAvailable = 0;
+    publishRoleDepths();
+}
+
+// Joins through enqueuePlayer from `threads` gateway threads, each with its own
+// source, under whatever admission settings are current. Returns millions of
+// join attempts per second.
+double benchmarkAdmissionCase(int threads, int joinsPerThread) {
+    resetQueuesForBenchmark();
+    initAdmission();
+    std::atomic<bool> go(false);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&, t]() {
+            int firstId = 1 + t * joinsPerThread;
+            Clock::time_point joined = Clock::now();
+            while (!go.load()) std::this_thread::yield();
+            for (int id = firstId; id < firstId + joinsPerThread; id++) {
+                enqueuePlayer(Player(id, static_cast<Role>(id % ROLE_COUNT), joined), t);
+            }
+        }));
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    go = true;
+    for (auto& worker : workers) worker.join();
+    std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+    return static_cast<double>(threads) * joinsPerThread / elapsed.count() / 1e6;
+}
+
+// Accepted joins against the two reject paths: a queue already at its cap, and
+// sources already over their rate. Each column is the whole workload on one path.
+void benchmarkAdmission() {
+    const int threadCounts[] = { 1, 4, 16, 64 };
+    const int totalJoins = 2000000;
+    double savedRate = admissionRate;
+    double savedBurst = admissionBurst;
+    int savedCap = maxQueueSize;
+    std::cout << "\n===== Admission Control Benchmark (" << std::thread::hardware_concurrency() << " hardware threads) =====" << std::endl;
+    std::cout << std::right << std::setw(8) << "threads" << std::setw(12) << "accept" << std::setw(14) << "queue full"
+        << std::setw(14) << "rate limited" << std::endl;
+    for (int threads : threadCounts) {
+        int joinsPerThread = totalJoins / threads;
+        admissionRate = 1e9; // a limit every join passes, so the accept path still pays for the token
+        admissionBurst = 1e6;
+        maxQueueSize = 0;
+        double accept = benchmarkAdmissionCase(threads, joinsPerThread);
+        admissionRate = 0.0;
+        maxQueueSize = 1;
+        enqueuePlayer(Player(INT_MAX, TANK, Clock::now()));
+        double full = benchmarkAdmissionCase(threads, joinsPerThread);
+        admissionRate = 1e-3;
+        admissionBurst = 1.0;
+        maxQueueSize = 0;
+        double limited = benchmarkAdmissionCase(threads, joinsPerThread);
+        std::cout << std::fixed << std::setprecision(2) << std::setw(8) << threads << std::setw(12) << accept
+            << std::setw(14) << full << std::setw(14) << limited << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << "(millions of join attempts per second; rejected " << rejectedQueueFull.load() << " queue full, "
+        << rejectedRateLimited.load() << " rate limited)" << std::endl;
+    std::cout << "===============================" << std::endl;
+    admissionRate = savedRate;
+    admissionBurst = savedBurst;
+    maxQueueSize = savedCap;
+    resetQueuesForBenchmark();
+    initAdmission();
+}
+
+// Match quality for skill matching, from the spread histogram
+void printSkillReport() {
+    if (skillWindow <= 0) return;
+    std::lock_guard<QueueMutex> lock(queueMutex);
+    long long parties = 0;
+    double spreadTotal = 0.0;
+    int maxBin = 0;
+    for (int bin = 0; bin < 400; bin++) {
+        parties += skillSpreadCounts[bin];
+        spreadTotal += skillSpreadCounts[bin] * (bin * 10 + 5.0);
+        if (skillSpreadCounts[bin] > 0) maxBin = bin;
+    }
+    auto spreadPercentile = [&](double p) {
+        long long rank = static_cast<long long>(p * (parties - 1)) + 1;
+        long long seen = 0;
+        for (int bin = 0; bin < 400; bin++) {
+            seen += skillSpreadCounts[bin];
+            if (seen >= rank) return (bin + 1) * 10;
+        }
+        return 4000;
+    };
+    long long elapsed = std::max(1LL, engineNow());
+    std::cout << "\n===== Skill Matching =====" << std::endl;
+    std::cout << std::fixed << std::setprecision(0) << "Window: +/-" << skillWindow << " rating, widening " << skillWidenRate << "/s to +/-" << skillMaxWindow << std::endl;
+    std::cout << std::fixed << std::setprecision(1) << "Parties: " << parties << " (" << parties * 60.0 / elapsed
+        << " per engine minute)" << std::endl;
+    if (parties > 0) {
+        std::cout << "Rating spread: mean " << spreadTotal / parties << ", p50 " << spreadPercentile(0.5) << ", p95 "
+            << spreadPercentile(0.95) << ", max " << (maxBin + 1) * 10 << " (upper edges of 10-point bins)" << std::endl;
+        std::cout << "Anchor window at match: mean +/-" << skillWindowTotal / parties << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << "===============================" << std::endl;
+}
+
+// Fills the live skill index with `players` players in a 1/1/3 mix, joined a
+// microsecond apart, and times `parties` calls to formParty. Returns microseconds
+// per party and the mean rating spread through *spread.
+double benchmarkSkillIndex(int players, int parties, double* spread) {
+    resetQueuesForBenchmark();
+    Clock::time_point base = Clock::now() - std::chrono::hours(1);
+    {
+        std::lock_guard<QueueMutex> lock(queueMutex);
+        for (int id = 1; id <= players; id++) {
+            Player player(id, id % PARTY_SIZE == 0 ? TANK : id % PARTY_SIZE == 1 ? HEALER : DPS, base + std::chrono::microseconds(id));
+            player.rating = drawRating(id);
+            joinLocked(player);
+        }
+    }
+    long long spreadTotal = 0;
+    int formed = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < parties; i++) {
+        Party party = formParty();
+        if (party.id == 0) break;
+        std::lock_guard<QueueMutex> lock(queueMutex);
+        int lowest = 4000;
+        int highest = 0;
+        for (PlayerHandle handle : party.members) {
+            const Player* member = playerSlots.get(handle);
+            lowest = std::min<int>(lowest, member->rating);
+            highest = std::max<int>(highest, member->rating);
+            activePlayers.erase(member->id);
+            playerSlots.remove(handle);
+        }
+        spreadTotal += highest - lowest;
+        formed++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    *spread = formed > 0 ? static_cast<double>(spreadTotal) / formed : 0.0;
+    return formed > 0 ? seconds * 1e6 / formed : 0.0;
+}
+
+// The same matches by brute force: the oldest player anchors, and each open slot
+// goes to the nearest-rated player in the window found by scanning the whole role
+double benchmarkSkillNaive(int players, int parties, double* spread) {
+    std::vector<Player> byRole[ROLE_COUNT];
+    Clock::time_point base = Clock::now() - std::chrono::hours(1);
+    for (int id = 1; id <= players; id++) {
+        Player player(id, id % PARTY_SIZE == 0 ? TANK : id % PARTY_SIZE == 1 ? HEALER : DPS, base + std::chrono::microseconds(id));
+        player.rating = drawRating(id);
+        byRole[player.role].push_back(player);
+    }
+    const int slots[ROLE_COUNT] = { 1, 1, 3 };
+    long long spreadTotal = 0;
+    int formed = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < parties; i++) {
+        int anchorRole = -1;
+        for (int role = 0; role < ROLE_COUNT; role++) {
+            if (!byRole[role].empty() && (anchorRole < 0 || byRole[role].front().joinTime < byRole[anchorRole].front().joinTime)) anchorRole = role;
+        }
+        if (anchorRole < 0) break;
+        Player anchor = byRole[anchorRole].front();
+        byRole[anchorRole].erase(byRole[anchorRole].begin());
+        int lowest = anchor.rating;
+        int highest = anchor.rating;
+        bool found = true;
+        for (int role = 0; role < ROLE_COUNT && found; role++) {
+            for (int slot = anchorRole == role ? 1 : 0; slot < slots[role] && found; slot++) {
+                size_t best = byRole[role].size();
+                for (size_t j = 0; j < byRole[role].size(); j++) {
+                    int distance = std::abs(byRole[role][j].rating - anchor.rating);
+                    if (distance <= skillWindow && (best == byRole[role].size() || distance < std::abs(byRole[role][best].rating - anchor.rating))) best = j;
+                }
+                found = best < byRole[role].size();
+                if (!found) break;
+                lowest = std::min<int>(lowest, byRole[role][best].rating);
+                highest = std::max<int>(highest, byRole[role][best].rating);
+                byRole[role].erase(byRole[role].begin() + best);
+            }
+        }
+        if (!found) break;
+        spreadTotal += highest - lowest;
+        formed++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    *spread = formed > 0 ? static_cast<double>(spreadTotal) / formed : 0.0;
+    return formed > 0 ? seconds * 1e6 / formed : 0.0;
+}
+
+void benchmarkSkillMatching() {
+    const int sizes[] = { 10000, 100000, 1000000 };
+    double savedWindow = skillWindow;
+    double savedWiden = skillWidenRate;
+    if (skillWindow <= 0) skillWindow = 100.0;
+    skillWidenRate = 0.0; // a fixed window, so both matchers see the same rule
+    std::cout << "\n===== Skill Matching Benchmark (window +/-" << skillWindow << ", ratings ~N(" << skillMean << ", "
+        << skillDeviation << ")) =====" << std::endl;
+    std::cout << std::right << std::setw(10) << "queued" << std::setw(14) << "index us/pty" << std::setw(14) << "index spread"
+        << std::setw(14) << "naive us/pty" << std::setw(14) << "naive spread" << std::endl;
+    for (int players : sizes) {
+        double indexSpread = 0.0;
+        double naiveSpread = 0.0;
+        double indexTime = benchmarkSkillIndex(players, std::min(20000, players / 10), &indexSpread);
+        std::cout << std::fixed << std::setprecision(2) << std::setw(10) << players << std::setw(14) << indexTime
+            << std::setprecision(1) << std::setw(14) << indexSpread;
+        if (players <= 100000) {
+            double naiveTime = benchmarkSkillNaive(players, std::min(2000, players / 10), &naiveSpread);
+            std::cout << std::setprecision(2) << std::setw(14) << naiveTime << std::setprecision(1) << std::setw(14) << naiveSpread;
+        }
+        else {
+            std::cout << std::setw(14) << "-" << std::setw(14) << "-";
+        }
+        std::cout << std::endl;
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << "(microseconds per party formed and mean rating spread; naive skipped where it would take minutes)" << std::endl;
+    std::cout << "===============================" << std::endl;
+    skillWindow = savedWindow;
+    skillWidenRate = savedWiden;
+    resetQueuesForBenchmark();
+}
+
+// Bench-only baseline for PlayerIdIndex with the same interface
+struct UnorderedIdSet {
+    std::unordered_set<int> ids;
+    bool insert(int id) { return ids.insert(id).second; }
+    bool erase(int id) { return ids.erase(id) > 0; }
+    // Bucket array plus one heap node per id (next pointer and value, rounded up to
+    // the 16-byte minimum of a typical malloc chunk plus its 8-byte header)
+    size_t memoryBytes() const {
+        size_t node = (sizeof(void*) + sizeof(int) + 8 + 15) / 16 * 16;
+        return ids.bucket_count() * sizeof(void*) + ids.size() * node;
+    }
+};
+
+// Replays a join/leave stream (negative entries are leaves) against one set type
+// and reports time per operation and memory per live id at the end
+template <typename IdSet>
+void benchmarkJoinIndex(const char* name, const std::vector<int>& ops, size_t live) {
+    long long accepted = 0;
+    long long rejected = 0;
+    IdSet set;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int op : ops) {
+        if (op < 0) set.erase(-op);
+        else if (set.insert(op)) accepted++;
+        else rejected++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+    std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(10) << seconds * 1e9 / ops.size() << std::setw(12) << accepted << std::setw(12) << rejected
+        << std::setw(12) << static_cast<double>(set.memoryBytes()) / live << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+}
+
+// Fills to `live` active players and then churns (every fresh join paired with the
+// oldest player leaving) while clients retry a recent join at the given rate
+void benchmarkJoins() {
+    const size_t scales[] = { 1000000, 4000000 };
+    const double retryRates[] = { 0.5, 0.9 };
+    for (size_t live : scales) {
+        for (double retryRate : retryRates) {
+            std::mt19937 gen(62);
+            std::bernoulli_distribution retry(retryRate);
+            std::uniform_int_distribution<> recent(0, 1023);
+            std::vector<int> ops;
+            ops.reserve(static_cast<size_t>(live * 2 / (1.0 - retryRate) * 1.5));
+            int nextId = 1;
+            while (nextId <= static_cast<int>(live * 2)) {
+                if (nextId > 1 && retry(gen)) {
+                    ops.push_back(std::max(1, nextId - 1 - recent(gen)));
+                    continue;
+                }
+                if (nextId > static_cast<int>(live)) ops.push_back(-(nextId - static_cast<int>(live)));
+                ops.push_back(nextId++);
+            }
+
+            std::cout << "\n===== Duplicate Join Benchmark (" << live << " live ids, " << static_cast<int>(retryRate * 100)
+                << "% retries, " << ops.size() << " ops) =====" << std::endl;
+            std::cout << std::left << std::setw(16) << "index" << std::right << std::setw(10) << "ns/op"
+                << std::setw(12) << "accepted" << std::setw(12) << "rejected" << std::setw(12) << "bytes/id" << std::endl;
+            benchmarkJoinIndex<PlayerIdIndex>("open addressing", ops, live);
+            benchmarkJoinIndex<UnorderedIdSet>("unordered_set", ops, live);
+        }
+    }
+    std::cout << "(unordered_set bytes/id assumes a 16-byte-granular malloc with an 8-byte header)" << std::endl;
+    std::cout << "===============================" << std::endl;
+}
+
+// Hand-rolled tokenizer over the mapped file: no streams, no allocation per token
+struct ScenarioLexer {
+    const char* p;
+    const char* end;
+
+    bool atLineEnd() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+        return p >= end || *p == '\n' || *p == '#';
+    }
+
+    bool word(const char** start, size_t* length) {
+        if (atLineEnd()) return false;
+        *start = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n' && *p != '#') p++;
+        *length = p - *start;
+        return true;
+    }
+
+    bool is(const char* keyword) {
+        const char* start;
+        size_t length;
+        const char* saved = p;
+        if (word(&start, &length) && length == std::strlen(keyword) && std::memcmp(start, keyword, length) == 0) return true;
+        p = saved;
+        return false;
+    }
+
+    bool number(double* value) {
+        if (atLineEnd()) return false;
+        const char* start = p;
+        double whole = 0.0;
+        while (p < end && *p >= '0' && *p <= '9') whole = whole * 10 + (*p++ - '0');
+        if (p < end && *p == '.') {
+            double scale = 0.1;
+            for (p++; p < end && *p >= '0' && *p <= '9'; p++, scale *= 0.1) whole += (*p - '0') * scale;
+        }
+        *value = whole;
+        return p > start;
+    }
+
+    // 90, 90s, 30m, 2h, 1h30m; a bare number is seconds
+    bool duration(int64_t* ms) {
+        if (atLineEnd()) return false;
+        double total = 0.0;
+        bool any = false;
+        while (p < end && ((*p >= '0' && *p <= '9') || *p == '.')) {
+            double amount;
+            if (!number(&amount)) return false;
+            double unit = 1000.0;
+            if (p < end && *p == 'h') unit = 3600000.0;
+            else if (p < end && *p == 'm') unit = 60000.0;
+            if (p < end && (*p == 'h' || *p == 'm' || *p == 's')) p++;
+            total += amount * unit;
+            any = true;
+        }
+        *ms = static_cast<int64_t>(total);
+        return any && (p >= end || *p == ' ' || *p == '\t' || *p == '\r' || *p == '\n' || *p == '#');
+    }
+
+    void nextLine() {
+        while (p < end && *p != '\n') p++;
+        if (p < end) p++;
+    }
+};
+
+bool parseScenarioText(const char* data, size_t size, Scenario& scenario) {
+    ScenarioLexer lexer = { data, data + size };
+    double rate = 0.0;
+    double mix[ROLE_COUNT] = { 1, 1, 3 };
+    int64_t clock = 0;
+    for (int line = 1; lexer.p < lexer.end; line++, lexer.nextLine()) {
+        if (lexer.atLineEnd()) continue;
+        bool ok = true;
+        if (lexer.is("phase")) {
+            ScenarioPhase phase = {};
+            const char* name = nullptr;
+            size_t length = 0;
+            int64_t duration = 0;
+            ok = lexer.word(&name, &length) && lexer.duration(&duration) && duration > 0;
+            if (ok) std::memcpy(phase.name, name, std::min(length, sizeof(phase.name) - 1));
+            phase.startMs = clock;
+            phase.endMs = clock + duration;
+            phase.rateFrom = rate;
+            phase.rateTo = rate;
+            while (ok && !lexer.atLineEnd()) {
+                if (lexer.is("arrivals")) {
+                    ok = lexer.number(&phase.rateFrom);
+                    phase.rateTo = phase.rateFrom;
+                    if (ok && !lexer.atLineEnd() && *lexer.p >= '0' && *lexer.p <= '9') ok = lexer.number(&phase.rateTo);
+                }
+                else if (lexer.is("mix")) {
+                    for (int role = 0; ok && role < ROLE_COUNT; role++) ok = lexer.number(&mix[role]);
+                    ok = ok && mix[TANK] + mix[HEALER] + mix[DPS] > 0;
+                }
+                else {
+                    ok = false;
+                }
+            }
+            std::copy(mix, mix + ROLE_COUNT, phase.mix);
+            rate = phase.rateTo;
+            clock = phase.endMs;
+            scenario.phases.push_back(phase);
+        }
+        else if (lexer.is("at")) {
+            ScenarioAction action = {};
+            double count = 0;
+            ok = lexer.duration(&action.atMs);
+            if (ok && lexer.is("fleet")) {
+                action.kind = SCENARIO_FLEET;
+                ok = lexer.number(&count) && count > 0;
+            }
+            else if (ok && lexer.is("fail")) {
+                action.kind = SCENARIO_FAIL;
+                action.durationMs = -1;
+                ok = lexer.number(&count) && count > 0;
+                if (ok && lexer.is("for")) ok = lexer.duration(&action.durationMs);
+            }
+            else {
+                ok = false;
+            }
+            action.count = static_cast<int32_t>(count);
+            ok = ok && lexer.atLineEnd();
+            scenario.actions.push_back(action);
+        }
+        else {
+            ok = false;
+        }
+        if (!ok) {
+            std::cerr << "Error: Scenario line " << line << " is not a valid phase or at directive." << std::endl;
+            return false;
+        }
+    }
+    std::stable_sort(scenario.actions.begin(), scenario.actions.end(),
+        [](const ScenarioAction& a, const ScenarioAction& b) { return a.atMs < b.atMs; });
+    if (scenario.phases.empty()) {
+        std::cerr << "Error: Scenario has no phases." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void putLittleEndian(std::string& out, uint64_t value, int bytes) {
+    for (int b = 0; b < bytes; b++) out.push_back(static_cast<char>(value >> (8 * b)));
+}
+
+uint64_t getLittleEndian(const unsigned char* data, int bytes) {
+    uint64_t value = 0;
+    for (int b = bytes - 1; b >= 0; b--) value = (value << 8) | data[b];
+    return value;
+}
+
+void putDouble(std::string& out, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    putLittleEndian(out, bits, 8);
+}
+
+double getDouble(const unsigned char* data) {
+    uint64_t bits = getLittleEndian(data, 8);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+bool parseScenarioBinary(const char* data, size_t size, Scenario& scenario) {
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    size_t header = sizeof(scenarioMagic) + 8;
+    if (size < header) return false;
+    size_t phaseCount = static_cast<size_t>(getLittleEndian(bytes + 8, 4));
+    size_t actionCount = static_cast<size_t>(getLittleEndian(bytes + 12, 4));
+    if (size != header + phaseCount * scenarioPhaseSize + actionCount * scenarioActionSize) {
+        std::cerr << "Error: Compiled scenario is truncated or corrupt." << std::endl;
+        return false;
+    }
+    const unsigned char* r = bytes + header;
+    scenario.phases.resize(phaseCount);
+    for (auto& phase : scenario.phases) {
+        std::memcpy(phase.name, r, sizeof(phase.name));
+        phase.name[sizeof(phase.name) - 1] = '\0';
+        phase.startMs = static_cast<int64_t>(getLittleEndian(r + 16, 8));
+        phase.endMs = static_cast<int64_t>(getLittleEndian(r + 24, 8));
+        phase.rateFrom = getDouble(r + 32);
+        phase.rateTo = getDouble(r + 40);
+        for (int role = 0; role < ROLE_COUNT; role++) phase.mix[role] = getDouble(r + 48 + 8 * role);
+        r += scenarioPhaseSize;
+    }
+    scenario.actions.resize(actionCount);
+    for (auto& action : scenario.actions) {
+        action.atMs = static_cast<int64_t>(getLittleEndian(r, 8));
+        action.kind = static_cast<uint32_t>(getLittleEndian(r + 8, 4));
+        action.count = static_cast<int32_t>(getLittleEndian(r + 12, 4));
+        action.durationMs = static_cast<int64_t>(getLittleEndian(r + 16, 8));
+        r += scenarioActionSize;
+    }
+    // Hold the file to what the text parser would have produced: phases back to
+    // back from zero, actions by time, and only fleet and fail directives
+    bool ok = !scenario.phases.empty();
+    int64_t clock = 0;
+    for (const auto& phase : scenario.phases) {
+        ok = ok && phase.startMs == clock && phase.endMs > phase.startMs && phase.rateFrom >= 0 && phase.rateTo >= 0
+            && phase.mix[TANK] >= 0 && phase.mix[HEALER] >= 0 && phase.mix[DPS] >= 0 && phase.mix[TANK] + phase.mix[HEALER] + phase.mix[DPS] > 0;
+        clock = phase.endMs;
+    }
+    int64_t previous = 0;
+    for (const auto& action : scenario.actions) {
+        ok = ok && action.atMs >= previous && action.count > 0
+            && (action.kind == SCENARIO_FLEET || (action.kind == SCENARIO_FAIL && action.durationMs >= -1));
+        previous = action.atMs;
+    }
+    if (!ok) std::cerr << "Error: Compiled scenario has invalid phases or actions." << std::endl;
+    return ok;
+}
+
+// Text or compiled, told apart by the magic
+bool loadScenario(const std::string& path, Scenario& scenario) {
+    Clock::time_point start = Clock::now();
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Error: Could not open scenario " << path << std::endl;
+        return false;
+    }
+    bool binary = file.size >= sizeof(scenarioMagic) && std::equal(scenarioMagic, scenarioMagic + sizeof(scenarioMagic), file.data);
+    bool ok = binary ? parseScenarioBinary(file.data, file.size, scenario) : parseScenarioText(file.data, file.size, scenario);
+    if (!ok) return false;
+    std::cout << "Loaded scenario " << path << (binary ? " (compiled)" : " (text)") << ": " << scenario.phases.size()
+        << " phases, " << scenario.actions.size() << " actions, " << scenario.lengthMs() / 60000.0 << " min, parsed in "
+        << std::chrono::duration<double, std::micro>(Clock::now() - start).count() << "us" << std::endl;
+    return true;
+}
+
+bool compileScenario(const std::string& inPath, const std::string& outPath) {
+    Scenario scenario;
+    if (!loadScenario(inPath, scenario)) return false;
+    std::string out(scenarioMagic, sizeof(scenarioMagic));
+    putLittleEndian(out, scenario.phases.size(), 4);
+    putLittleEndian(out, scenario.actions.size(), 4);
+    for (const auto& phase : scenario.phases) {
+        out.append(phase.name, sizeof(phase.name));
+        putLittleEndian(out, static_cast<uint64_t>(phase.startMs), 8);
+        putLittleEndian(out, static_cast<uint64_t>(phase.endMs), 8);
+        putDouble(out, phase.rateFrom);
+        putDouble(out, phase.rateTo);
+        for (double weight : phase.mix) putDouble(out, weight);
+    }
+    for (const auto& action : scenario.actions) {
+        putLittleEndian(out, static_cast<uint64_t>(action.atMs), 8);
+        putLittleEndian(out, action.kind, 4);
+        putLittleEndian(out, static_cast<uint32_t>(action.count), 4);
+        putLittleEndian(out, static_cast<uint64_t>(action.durationMs), 8);
+    }
+    std::ofstream file(outPath, std::ios::binary | std::ios::trunc);
+    if (!file.write(out.data(), out.size())) {
+        std::cerr << "Error: Could not write " << outPath << std::endl;
+        return false;
+    }
+    std::cout << "Compiled " << inPath << " to " << outPath << " (" << out.size() << " bytes)" << std::endl;
+    return true;
+}
+
+// Share of each role's usual turnout by hour of day. Tanks and, less so, healers
+// thin out overnight, when the queue is mostly casual DPS.
+const double tankHourFactor[24] = { 0.7, 0.6, 0.5, 0.45, 0.45, 0.5, 0.6, 0.75, 0.85, 0.9, 0.95, 1.0,
+    1.0, 1.0, 1.0, 1.0, 1.0, 1.05, 1.1, 1.1, 1.1, 1.05, 0.95, 0.8 };
+const double healerHourFactor[24] = { 0.8, 0.75, 0.7, 0.65, 0.65, 0.7, 0.75, 0.85, 0.9, 0.95, 1.0, 1.0,
+    1.0, 1.0, 1.0, 1.0, 1.0, 1.0, 1.05, 1.05, 1.05, 1.0, 0.95, 0.9 };
+
+void hourlyRoleMix(int hour, int tankWeight, int healerWeight, int dpsWeight, double* mix) {
+    mix[TANK] = tankWeight * tankHourFactor[hour % 24];
+    mix[HEALER] = healerWeight * healerHourFactor[hour % 24];
+    mix[DPS] = dpsWeight;
+}
+
+// One "<minute> <joins>" or "<HH:MM> <joins>" per line, '#' comments; minutes
+// not listed had no joins. Minutes past 1440 continue into later days.
+bool loadArrivalTrace(const std::string& path, std::vector<double>& perMinute) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Error: Could not open arrival trace " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); lineNumber++) {
+        size_t comment = line.find('#');
+        if (comment != std::string::npos) line.erase(comment);
+        std::istringstream iss(line);
+        std::string when;
+        double joins = 0;
+        if (!(iss >> when)) continue;
+        size_t colon = when.find(':');
+        char* end = nullptr;
+        long minute = std::strtol(when.c_str(), &end, 10);
+        if (colon != std::string::npos && end == when.c_str() + colon) {
+            minute = minute * 60 + std::strtol(when.c_str() + colon + 1, &end, 10);
+        }
+        if (*end != '\0' || minute < 0 || !(iss >> joins) || joins < 0) {
+            std::cerr << "Error: Arrival trace line " << lineNumber << " is not '<minute> <joins>'." << std::endl;
+            return false;
+        }
+        if (static_cast<size_t>(minute) >= perMinute.size()) perMinute.resize(minute + 1, 0.0);
+        perMinute[minute] += joins;
+    }
+    if (perMinute.empty()) {
+        std::cerr << "Error: Arrival trace " << path << " has no joins." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// The diurnal and trace models as a scenario of one-minute phases, so the live
+// engine and the simulator both follow them without a second arrival path. The
+// diurnal curve is a cosine around meanPerSecond peaking at diurnal-peak-hour and
+// repeats every 24 h; the trace holds each minute at its recorded count and ends
+// with the trace. Day starts at engine time 0.
+bool buildArrivalScenario(double meanPerSecond, int tankWeight, int healerWeight, int dpsWeight, Scenario& out) {
+    std::vector<double> perMinute;
+    if (arrivalModel == ArrivalModel::Trace) {
+        if (arrivalTracePath.empty()) {
+            std::cerr << "Error: arrival-model trace needs arrival-trace in config.txt" << std::endl;
+            return false;
+        }
+        if (!loadArrivalTrace(arrivalTracePath, perMinute)) return false;
+    }
+    else {
+        const double pi = 3.14159265358979323846;
+        perMinute.resize(24 * 60 + 1);
+        for (size_t minute = 0; minute < perMinute.size(); minute++) {
+            double hours = minute / 60.0 - diurnalPeakHour;
+            perMinute[minute] = meanPerSecond * 60.0 * (1.0 + diurnalSwing * std::cos(2 * pi * hours / 24.0));
+        }
+    }
+
+    size_t minutes = arrivalModel == ArrivalModel::Trace ? perMinute.size() : perMinute.size() - 1;
+    out = Scenario();
+    out.repeats = arrivalModel == ArrivalModel::Diurnal;
+    out.phases.resize(minutes);
+    for (size_t minute = 0; minute < minutes; minute++) {
+        ScenarioPhase& phase = out.phases[minute];
+        std::snprintf(phase.name, sizeof(phase.name), "%02d:%02d", static_cast<int>(minute / 60 % 24), static_cast<int>(minute % 60));
+        phase.startMs = static_cast<int64_t>(minute) * 60000;
+        phase.endMs = phase.startMs + 60000;
+        phase.rateFrom = perMinute[minute];
+        phase.rateTo = arrivalModel == ArrivalModel::Trace ? perMinute[minute] : perMinute[minute + 1];
+        hourlyRoleMix(static_cast<int>(minute / 60), tankWeight, healerWeight, dpsWeight, phase.mix);
+    }
+    return true;
+}
+
+// Role for a scenario join given a uniform draw in [0, 1)
+Role scenarioRole(const ScenarioPhase& phase, double u) {
+    double pick = u * (phase.mix[TANK] + phase.mix[HEALER] + phase.mix[DPS]);
+    if (pick < phase.mix[TANK]) return TANK;
+    if (pick < phase.mix[TANK] + phase.mix[HEALER]) return HEALER;
+    return DPS;
+}
+
+// splitmix64 over (shard, counter, stream): the simulator's only source of randomness
+uint64_t simHash(uint64_t shard, uint64_t counter, uint64_t stream) {
+    uint64_t x = simSeed ^ (shard * 0x9E3779B97F4A7C15ULL) ^ (counter * 0xC2B2AE3D27D4EB4FULL) ^ (stream << 56);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+void simInitShard(SimShard& shard, int id, const SimParams& params, SimOutput& out) {
+    shard.id = id;
+    shard.sc = SimScalars();
+    shard.sc.capacity = simShare(params.instances, params.shards, id);
+    shard.sc.freeInstances = shard.sc.capacity;
+    if (params.scenario) {
+        // Candidate arrivals at the peak rate, thinned to the scenario's rate as they land
+        double peakPerMinute = params.scenarioPeak / params.shards;
+        shard.arrivalMeanMs = peakPerMinute > 0 ? 60000.0 / peakPerMinute : 1e12;
+        if (!params.scenarioSteps.empty()) {
+            SimEvent step = { params.scenarioSteps[0].atMs, SIM_SCENARIO, id, id, 0 };
+            out.push(step);
+        }
+    }
+    else {
+        // External joins sized for ~90% utilisation once replays are counted
+        double meanClearSeconds = (params.minMs + params.maxMs) / 2000.0;
+        double playersPerSecond = 0.9 * shard.sc.freeInstances / meanClearSeconds * PARTY_SIZE * (100 - params.replayPercent) / 100.0;
+        shard.arrivalMeanMs = playersPerSecond > 0 ? 1000.0 / playersPerSecond : 1e12;
+    }
+    SimEvent first = { static_cast<int64_t>(simHash(id, 0, 2) % static_cast<uint64_t>(shard.arrivalMeanMs + 1)),
+        SIM_ARRIVAL, id, id, 0 };
+    out.push(first);
+}
+
+// A shard's slice of a fleet-wide instance count
+int simShare(int total, int shards, int id) {
+    return total / shards + (id < total % shards ? 1 : 0);
+}
+
+// Clear times are sampled a block of parties at a time with the batch sampler
+int64_t simClearTimeMs(SimShard& shard, uint64_t partySeq, const SimParams& params) {
+    uint64_t block = partySeq / simClearBlock;
+    if (block != shard.clearBlock) {
+        ClearTimeSampler sampler(simHash(shard.id, block, 3), params.distribution, params.minMs / 1000.0,
+            params.maxMs / 1000.0, params.sigma);
+        double seconds[simClearBlock];
+        sampler.fill(seconds, simClearBlock);
+        shard.clearTimes.resize(simClearBlock);
+        for (uint64_t i = 0; i < simClearBlock; i++) {
+            shard.clearTimes[i] = std::max(params.minMs, std::min(params.maxMs, static_cast<int64_t>(seconds[i] * 1000.0)));
+        }
+        shard.clearBlock = block;
+    }
+    return shard.clearTimes[partySeq % simClearBlock];
+}
+
+void simHandle(SimShard& shard, const SimEvent& event, const SimParams& params, SimOutput& out) {
+    SimScalars& sc = shard.sc;
+    sc.events++;
+    shard.advanceHour(event.time);
+    if (event.type == SIM_ARRIVAL) {
+        const ScenarioPhase* phase = params.scenario ? params.scenario->phaseAt(event.time) : nullptr;
+        if (!params.scenario) {
+            uint64_t pick = simHash(shard.id, sc.arrivalSeq, 1) % 5;
+            shard.push(pick == 0 ? TANK : pick == 1 ? HEALER : DPS, event.time);
+            sc.arrivals++;
+        }
+        else if (phase && simUnit(simHash(shard.id, sc.arrivalSeq, 5)) * params.scenarioPeak < params.scenario->rateAt(event.time)) {
+            shard.push(scenarioRole(*phase, simUnit(simHash(shard.id, sc.arrivalSeq, 1))), event.time);
+            sc.arrivals++;
+        }
+        double u = (simHash(shard.id, sc.arrivalSeq, 2) >> 11) * (1.0 / 9007199254740992.0);
+        sc.arrivalSeq++;
+        SimEvent next = { event.time + static_cast<int64_t>(-std::log(1.0 - u) * shard.arrivalMeanMs),
+            SIM_ARRIVAL, shard.id, shard.id, sc.arrivalSeq };
+        out.push(next);
+    }
+    else if (event.type == SIM_REJOIN) {
+        shard.push(TANK, event.time);
+        shard.push(HEALER, event.time);
+        for (int i = 0; i < 3; i++) shard.push(DPS, event.time);
+        sc.rejoins += PARTY_SIZE;
+    }
+    else if (event.type == SIM_SCENARIO) {
+        const ScenarioAction& step = params.scenarioSteps[static_cast<size_t>(event.seq)];
+        int share = simShare(step.count, params.shards, shard.id);
+        if (step.kind == SCENARIO_FLEET) {
+            sc.freeInstances += share - sc.capacity;
+            sc.capacity = share;
+        }
+        else if (step.kind == SCENARIO_FAIL) {
+            sc.freeInstances -= share;
+        }
+        else {
+            sc.freeInstances += share;
+        }
+        if (event.seq + 1 < params.scenarioSteps.size()) {
+            SimEvent next = { params.scenarioSteps[static_cast<size_t>(event.seq + 1)].atMs, SIM_SCENARIO, shard.id, shard.id, event.seq + 1 };
+            out.push(next);
+        }
+    }
+    else if (event.type == SIM_COMPLETE) {
+        sc.freeInstances++;
+        sc.completions++;
+        sc.hour.completions++;
+    }
+
+    // At most one party forms per event; if another could form too (a scenario
+    // step freed many instances, or a kick found a backlog), a kick at the same
+    // time carries on matching, so every backend sees the same event sequence
+    if (sc.freeInstances > 0 && shard.depth(TANK) >= 1 && shard.depth(HEALER) >= 1 && shard.depth(DPS) >= 3) {
+        int64_t joined[PARTY_SIZE] = { shard.pop(TANK), shard.pop(HEALER), shard.pop(DPS), shard.pop(DPS), shard.pop(DPS) };
+        for (int64_t join : joined) {
+            sc.waitSumMs += event.time - join;
+            sc.waitMaxMs = std::max(sc.waitMaxMs, event.time - join);
+            sc.hour.waits++;
+            sc.hour.waitSumMs += event.time - join;
+            sc.hour.waitMaxMs = std::max(sc.hour.waitMaxMs, event.time - join);
+            sc.hour.histogram[log2Bucket((event.time - join) / 1000.0)]++;
+        }
+        sc.freeInstances--;
+        sc.parties++;
+        int64_t clearMs = simClearTimeMs(shard, sc.partySeq, params);
+        SimEvent done = { event.time + clearMs, SIM_COMPLETE, shard.id, shard.id, sc.partySeq };
+        out.push(done);
+        uint64_t replay = simHash(shard.id, sc.partySeq, 4);
+        if (static_cast<int>(replay % 100) < params.replayPercent) {
+            SimEvent rejoin = { event.time + clearMs, SIM_REJOIN, shard.id, static_cast<int32_t>((replay >> 8) % params.shards), sc.partySeq };
+            out.push(rejoin);
+        }
+        sc.partySeq++;
+        if (sc.freeInstances > 0 && shard.depth(TANK) >= 1 && shard.depth(HEALER) >= 1 && shard.depth(DPS) >= 3) {
+            SimEvent kick = { event.time, SIM_KICK, shard.id, shard.id, sc.partySeq };
+            out.push(kick);
+        }
+    }
+}
+
+double simUnit(uint64_t bits) {
+    return (bits >> 11) * (1.0 / 9007199254740992.0);
+}
+
+SimResult simCollect(const std::vector<SimShard*>& shards) {
+    SimResult result;
+    for (const SimShard* shard : shards) {
+        const SimScalars& sc = shard->sc;
+        result.events += sc.events;
+        result.arrivals += sc.arrivals;
+        result.rejoins += sc.rejoins;
+        result.parties += sc.parties;
+        result.completions += sc.completions;
+        result.waitSumMs += sc.waitSumMs;
+        result.waitMaxMs = std::max(result.waitMaxMs, sc.waitMaxMs);
+        result.checksum = simHash(result.checksum, sc.partySeq ^ (sc.arrivalSeq << 20), sc.freeInstances) ^
+            static_cast<uint64_t>(shard->depth(TANK) * 31 + shard->depth(HEALER) * 17 + shard->depth(DPS));
+
+        // Fold the shard's hours, the open one included, into the fleet-wide report
+        if (result.hours.size() < static_cast<size_t>(sc.hourIndex) + 1) result.hours.resize(static_cast<size_t>(sc.hourIndex) + 1);
+        for (int64_t h = 0; h <= sc.hourIndex; h++) {
+            const SimHour& part = h < sc.hourIndex ? shard->hours[static_cast<size_t>(h)] : sc.hour;
+            HourlyReport::Hour& hour = result.hours[static_cast<size_t>(h)];
+            for (int role = 0; role < ROLE_COUNT; role++) hour.joins[role] += part.joins[role];
+            hour.parties += part.completions;
+            hour.waits += part.waits;
+            hour.waitSum += part.waitSumMs / 1000.0;
+            hour.waitMax = std::max(hour.waitMax, part.waitMaxMs / 1000.0);
+            for (int b = 0; b < 32; b++) hour.histogram[b] += part.histogram[b];
+        }
+    }
+    return result;
+}
+
+SimResult runSequentialSim(const SimParams& params) {
+    std::vector<SimShard> shards(params.shards);
+    std::priority_queue<SimEvent, std::vector<SimEvent>, std::greater<SimEvent>> events;
+    for (int i = 0; i < params.shards; i++) {
+        SimOutput out;
+        simInitShard(shards[i], i, params, out);
+        for (int e = 0; e < out.count; e++) events.push(out.events[e]);
+    }
+    while (!events.empty() && events.top().time < params.endMs) {
+        SimEvent event = events.top();
+        events.pop();
+        SimShard& shard = shards[event.dest];
+        SimOutput out;
+        simHandle(shard, event, params, out);
+        for (int e = 0; e < out.count; e++) events.push(out.events[e]);
+        shard.compact(shard.sc.head);
+    }
+
+    std::vector<SimShard*> pointers;
+    for (auto& shard : shards) pointers.push_back(&shard);
+    return simCollect(pointers);
+}
+
+// Optimistic (Time Warp) backend. Each thread owns every threads-th shard and runs
+// its shards' events in order without waiting for the others. A message arriving
+// in a shard's past rolls the shard back: saved scalars are restored, queues are
+// truncated, and anti-messages cancel whatever the undone events sent. GVT is
+// found in a stop-the-world round once all in-flight messages are delivered, and
+// history older than GVT is discarded.
+struct TimeWarpSim {
+    struct Message {
+        SimEvent event;
+        bool anti;
+    };
+    struct Processed {
+        SimEvent event;
+        SimScalars before;
+        SimOutput out;
+    };
+    struct Process {
+        SimShard shard;
+        std::set<SimEvent> pending;
+        std::deque<Processed> processed;
+    };
+    struct Inbox {
+        std::mutex mutex;
+        std::vector<Message> messages; // FIFO per sender, so an anti-message never overtakes its message
+    };
+
+    const SimParams& params;
+    int threads;
+    int64_t window; // how far past GVT a shard may run ahead
+    std::vector<Process> processes;
+    std::vector<std::unique_ptr<Inbox>> inboxes;
+    SimBarrier barrier;
+    std::atomic<long long> inFlight;
+    std::atomic<bool> gvtRequested;
+    std::atomic<int64_t> gvtCandidate;
+    std::atomic<long long> rolledBack;
+    int64_t gvt = 0; // only written between barriers
+    bool done = false;
+    long long rounds = 0;
+
+    TimeWarpSim(const SimParams& simParams, int threadCount)
+        : params(simParams), threads(threadCount), window(std::max<int64_t>(4 * simParams.maxMs, 10000)),
+        processes(simParams.shards), barrier(threadCount), inFlight(0), gvtRequested(false),
+        gvtCandidate(INT64_MAX), rolledBack(0) {
+        for (int i = 0; i < threads; i++) inboxes.emplace_back(new Inbox());
+        for (int i = 0; i < params.shards; i++) {
+            SimOutput out;
+            simInitShard(processes[i].shard, i, params, out);
+            for (int e = 0; e < out.count; e++) processes[i].pending.insert(out.events[e]);
+        }
+    }
+
+    SimResult run() {
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; i++) workers.push_back(std::thread(&TimeWarpSim::worker, this, i));
+        for (auto& worker : workers) worker.join();
+
+        std::vector<SimShard*> shards;
+        for (auto& process : processes) shards.push_back(&process.shard);
+        SimResult result = simCollect(shards);
+        result.rolledBack = rolledBack.load();
+        result.syncRounds = rounds;
+        return result;
+    }
+
+    void send(const SimEvent& event, bool anti) {
+        inFlight.fetch_add(1);
+        Inbox& inbox = *inboxes[event.dest % threads];
+        std::lock_guard<std::mutex> lock(inbox.mutex);
+        inbox.messages.push_back(Message{ event, anti });
+    }
+
+    void drain(int thread) {
+        std::vector<Message> batch;
+        {
+            std::lock_guard<std::mutex> lock(inboxes[thread]->mutex);
+            batch.swap(inboxes[thread]->messages);
+        }
+        for (const auto& message : batch) {
+            Process& process = processes[message.event.dest];
+            if (message.anti) {
+                if (!process.pending.count(message.event)) rollback(process, message.event);
+                process.pending.erase(message.event);
+            }
+            else {
+                if (!process.processed.empty() && message.event < process.processed.back().event) {
+                    rollback(process, message.event);
+                }
+                process.pending.insert(message.event);
+            }
+            inFlight.fetch_sub(1);
+        }
+    }
+
+    // Undoes every processed event at or after key, latest first
+    void rollback(Process& process, const SimEvent& key) {
+        while (!process.processed.empty() && !(process.processed.back().event < key)) {
+            const Processed& undone = process.processed.back();
+            process.shard.restore(undone.before);
+            for (int e = 0; e < undone.out.count; e++) {
+                const SimEvent& sent = undone.out.events[e];
+                if (sent.dest == process.shard.id) process.pending.erase(sent);
+                else send(sent, true);
+            }
+            process.pending.insert(undone.event);
+            process.processed.pop_back();
+            rolledBack.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void execute(Process& process) {
+        Processed record;
+        record.event = *process.pending.begin();
+        record.before = process.shard.sc;
+        process.pending.erase(process.pending.begin());
+        simHandle(process.shard, record.event, params, record.out);
+        for (int e = 0; e < record.out.count; e++) {
+            const SimEvent& event = record.out.events[e];
+            if (event.dest == process.shard.id) process.pending.insert(event);
+            else send(event, false);
+        }
+        process.processed.push_back(record);
+    }
+
+    void worker(int thread) {
+        const long long gvtInterval = 8192;
+        long long sinceGvt = 0;
+        while (true) {
+            drain(thread);
+            if (gvtRequested.load(std::memory_order_relaxed)) {
+                if (!gvtRound(thread)) return;
+                sinceGvt = 0;
+                continue;
+            }
+            int64_t limit = std::min(params.endMs, gvt + window);
+            Process* next = nullptr;
+            for (int i = thread; i < params.shards; i += threads) {
+                Process& process = processes[i];
+                if (process.pending.empty() || process.pending.begin()->time >= limit) continue;
+                if (!next || *process.pending.begin() < *next->pending.begin()) next = &process;
+            }
+            if (!next || ++sinceGvt >= gvtInterval) gvtRequested = true;
+            if (next) execute(*next);
+        }
+    }
+
+    // False once GVT has passed the end of the run
+    bool gvtRound(int thread) {
+        barrier.wait();
+        while (true) {
+            drain(thread);
+            barrier.wait();
+            bool quiet = inFlight.load() == 0; // nobody sends between these two barriers
+            barrier.wait();
+            if (quiet) break;
+        }
+
+        int64_t local = INT64_MAX;
+        for (int i = thread; i < params.shards; i += threads) {
+            if (!processes[i].pending.empty()) local = std::min(local, processes[i].pending.begin()->time);
+        }
+        int64_t current = gvtCandidate.load();
+        while (local < current && !gvtCandidate.compare_exchange_weak(current, local)) {}
+        if (barrier.wait()) {
+            gvt = gvtCandidate.exchange(INT64_MAX);
+            done = gvt >= params.endMs;
+            gvtRequested = false;
+            rounds++;
+        }
+        barrier.wait();
+        if (done) return false;
+
+        // Fossil collection: nothing before GVT can be rolled back any more
+        for (int i = thread; i < params.shards; i += threads) {
+            Process& process = processes[i];
+            while (!process.processed.empty() && process.processed.front().event.time < gvt) {
+                process.processed.pop_front();
+            }
+            process.shard.compact(process.processed.empty() ? process.shard.sc.head : process.processed.front().before.head);
+        }
+        return true;
+    }
+};
+
+SimResult runTimeWarpSim(const SimParams& params, int threads) {
+    TimeWarpSim sim(params, threads);
+    return sim.run();
+}
+
+// Conservative backend. A party formed at time t reports its completion and its
+// players' rejoin at t + clear >= t + t1 right away, so nothing a shard does at
+// time t can reach another shard before t + t1. Each round every shard therefore
+// safely runs all events before (global earliest pending time + t1) with no
+// rollback, then the threads meet at a barrier and swap messages.
+struct ConservativeSim {
+    typedef std::priority_queue<SimEvent, std::vector<SimEvent>, std::greater<SimEvent>> EventHeap;
+    struct Inbox {
+        std::mutex mutex;
+        std::vector<SimEvent> events;
+    };
+
+    const SimParams& params;
+    int threads;
+    std::vector<SimShard> shards;
+    std::vector<EventHeap> pending;
+    std::vector<std::unique_ptr<Inbox>> inboxes;
+    SimBarrier barrier;
+    std::atomic<int64_t> earliest;
+    int64_t windowEnd = 0; // only written between barriers
+    bool done = false;
+    long long rounds = 0;
+
+    ConservativeSim(const SimParams& simParams, int threadCount)
+        : params(simParams), threads(threadCount), shards(simParams.shards), pending(simParams.shards),
+        barrier(threadCount), earliest(INT64_MAX) {
+        for (int i = 0; i < threads; i++) inboxes.emplace_back(new Inbox());
+        for (int i = 0; i < params.shards; i++) {
+            SimOutput out;
+            simInitShard(shards[i], i, params, out);
+            for (int e = 0; e < out.count; e++) pending[i].push(out.events[e]);
+        }
+    }
+
+    SimResult run() {
+        std::vector<std::thread> workers;
+        for (int i = 0; i < threads; i++) workers.push_back(std::thread(&ConservativeSim::worker, this, i));
+        for (auto& worker : workers) worker.join();
+
+        std::vector<SimShard*> pointers;
+        for (auto& shard : shards) pointers.push_back(&shard);
+        SimResult result = simCollect(pointers);
+        result.syncRounds = rounds;
+        return result;
+    }
+
+    void worker(int thread) {
+        while (true) {
+            std::vector<SimEvent> batch;
+            {
+                std::lock_guard<std::mutex> lock(inboxes[thread]->mutex);
+                batch.swap(inboxes[thread]->events);
+            }
+            for (const auto& event : batch) pending[event.dest].push(event);
+
+            int64_t local = INT64_MAX;
+            for (int i = thread; i < params.shards; i += threads) {
+                if (!pending[i].empty()) local = std::min(local, pending[i].top().time);
+            }
+            int64_t current = earliest.load();
+            while (local < current && !earliest.compare_exchange_weak(current, local)) {}
+            if (barrier.wait()) {
+                int64_t lowerBound = earliest.exchange(INT64_MAX);
+                done = lowerBound >= params.endMs;
+                windowEnd = done ? lowerBound : std::min(params.endMs, lowerBound + params.minMs);
+                rounds++;
+            }
+            barrier.wait();
+            if (done) return;
+
+            for (int i = thread; i < params.shards; i += threads) {
+                SimShard& shard = shards[i];
+                while (!pending[i].empty() && pending[i].top().time < windowEnd) {
+                    SimEvent event = pending[i].top();
+                    pending[i].pop();
+                    SimOutput out;
+                    simHandle(shard, event, params, out);
+                    for (int e = 0; e < out.count; e++) {
+                        const SimEvent& sent = out.events[e];
+                        if (sent.dest == shard.id) {
+                            pending[i].push(sent);
+                            continue;
+                        }
+                        Inbox& inbox = *inboxes[sent.dest % threads];
+                        std::lock_guard<std::mutex> lock(inbox.mutex);
+                        inbox.events.push_back(sent);
+                    }
+                    shard.compact(shard.sc.head);
+                }
+            }
+            barrier.wait(); // every message for the next window is posted
+        }
+    }
+};
+
+SimResult runConservativeSim(const SimParams& params, int threads) {
+    ConservativeSim sim(params, threads);
+    return sim.run();
+}
+
+void printSimResult(const char* backend, int threads, const SimParams& params, const SimResult& result, double wallSeconds) {
+    double simulatedHours = params.endMs / 3600000.0;
+    std::cout << "\n===== Simulation: " << backend << ", " << threads << (threads == 1 ? " thread" : " threads") << " =====" << std::endl;
+    std::cout << "  Fleet: " << params.instances << " instances in " << params.shards << " shards, t1 "
+        << params.minMs / 1000 << "s, t2 " << params.maxMs / 1000 << "s, " << simulatedHours << " simulated hours" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "  Events: " << result.events << " committed, " << result.rolledBack << " rolled back, "
+        << result.syncRounds << " sync rounds" << std::endl;
+    std::cout << "  Wall time: " << wallSeconds << "s (" << (wallSeconds > 0 ? result.events / wallSeconds / 1e6 : 0.0)
+        << "M events/s, " << (wallSeconds > 0 ? simulatedHours / wallSeconds * 60 : 0.0) << " simulated hours per wall minute)" << std::endl;
+    std::cout << "  Parties: " << result.parties << " formed, " << result.completions << " completed, mean wait "
+        << (result.parties > 0 ? result.waitSumMs / 1000.0 / (result.parties * PARTY_SIZE) : 0.0) << "s, max wait "
+        << result.waitMaxMs / 1000.0 << "s" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << "  Players: " << result.arrivals << " joined, " << result.rejoins << " rejoined" << std::endl;
+    std::cout << "  Checksum: " << std::hex << result.checksum << std::dec << std::endl;
+}
+
+// --simulate <sequential|time-warp|conservative|compare>; compare runs all three
+// and checks the parallel outcomes match the sequential one
+int runSimulation(const std::string& backend, int t1, int t2, const Scenario* scenario) {
+    if (backend != "sequential" && backend != "time-warp" && backend != "conservative" && backend != "compare") {
+        std::cerr << "Error: Unknown simulation backend " << backend << " (sequential, time-warp, conservative or compare)" << std::endl;
+        return 1;
+    }
+    SimParams params;
+    params.shards = std::min(simShards, simInstances);
+    params.instances = simInstances;
+    params.minMs = (t1 > 0 ? t1 : 4) * 1000LL;
+    params.maxMs = std::max<int64_t>((t2 > t1 ? t2 : 15) * 1000LL, params.minMs);
+    params.endMs = static_cast<int64_t>(simHours * 3600000.0);
+    params.replayPercent = 50;
+    params.distribution = clearTimeDistribution;
+    params.sigma = clearTimeSigma;
+    params.scenario = scenario;
+    if (scenario) {
+        // A repeating curve runs for sim-hours like the steady model
+        if (!scenario->repeats) params.endMs = scenario->lengthMs();
+        params.scenarioSteps = scenario->timeline(static_cast<int64_t>(recoveryTime * 1000));
+        params.scenarioPeak = scenario->peakRate();
+    }
+    int threads = simThreads > 0 ? simThreads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+    bool compare = backend == "compare";
+    SimResult sequential;
+    SimResult first; // the first backend's run, for the hourly report
+    auto keepFirst = [&first](const SimResult& result) {
+        if (first.hours.empty()) first = result;
+    };
+    bool identical = true;
+    if (backend == "sequential" || compare) {
+        auto start = std::chrono::high_resolution_clock::now();
+        sequential = runSequentialSim(params);
+        printSimResult("sequential", 1, params, sequential,
+            std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+        keepFirst(sequential);
+    }
+    if (backend == "time-warp" || compare) {
+        auto start = std::chrono::high_resolution_clock::now();
+        SimResult optimistic = runTimeWarpSim(params, threads);
+        printSimResult("time-warp", threads, params, optimistic,
+            std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+        keepFirst(optimistic);
+        if (compare) {
+            identical = identical && optimistic.sameOutcome(sequential);
+            std::cout << "  Identical to sequential: " << (optimistic.sameOutcome(sequential) ? "yes" : "NO") << std::endl;
+        }
+    }
+    if (backend == "conservative" || compare) {
+        auto start = std::chrono::high_resolution_clock::now();
+        SimResult windowed = runConservativeSim(params, threads);
+        printSimResult("conservative", threads, params, windowed,
+            std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count());
+        keepFirst(windowed);
+        if (compare) {
+            identical = identical && windowed.sameOutcome(sequential);
+            std::cout << "  Identical to sequential: " << (windowed.sameOutcome(sequential) ? "yes" : "NO") << std::endl;
+        }
+    }
+    std::cout << "===============================" << std::endl;
+    if (scenario) {
+        // Same per-hour table as the live engine, from simulated time
+        {
+            std::lock_guard<std::mutex> lock(rollingMutex);
+            hourlyReport.hours = first.hours;
+            hourlyReport.finish(params.endMs / 1000.0);
+        }
+        printHourlyReport();
+    }
+    return identical ? 0 : 1;
+}
+
+// Wall time of each backend against the sequential simulator as t1/t2 varies.
+// The conservative window is t1 wide, so short minimum clears mean many barriers,
+// while time warp pays for rollbacks instead.
+void benchmarkSimulation(int threads) {
+    const int clearRanges[][2] = { { 1, 15 }, { 4, 15 }, { 8, 15 }, { 12, 15 }, { 15, 15 } };
+    std::cout << "\n===== Parallel Simulation Benchmark (" << simInstances << " instances, " << simShards << " shards, "
+        << simHours << " simulated hours, " << threads << " threads, " << std::thread::hardware_concurrency()
+        << " hardware threads) =====" << std::endl;
+    std::cout << std::right << std::setw(8) << "t1/t2" << std::setw(12) << "seq s" << std::setw(12) << "warp s"
+        << std::setw(10) << "speedup" << std::setw(12) << "rollbacks" << std::setw(12) << "cons s"
+        << std::setw(10) << "speedup" << std::setw(10) << "windows" << std::setw(11) << "identical" << std::endl;
+    for (const auto& range : clearRanges) {
+        SimParams params;
+        params.shards = std::min(simShards, simInstances);
+        params.instances = simInstances;
+        params.minMs = range[0] * 1000LL;
+        params.maxMs = range[1] * 1000LL;
+        params.endMs = static_cast<int64_t>(simHours * 3600000.0);
+        params.replayPercent = 50;
+        params.distribution = clearTimeDistribution;
+        params.sigma = clearTimeSigma;
+        params.scenario = nullptr;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        SimResult sequential = runSequentialSim(params);
+        auto afterSequential = std::chrono::high_resolution_clock::now();
+        SimResult optimistic = runTimeWarpSim(params, threads);
+        auto afterWarp = std::chrono::high_resolution_clock::now();
+        SimResult windowed = runConservativeSim(params, threads);
+        auto end = std::chrono::high_resolution_clock::now();
+
+        double sequentialSeconds = std::chrono::duration<double>(afterSequential - start).count();
+        double warpSeconds = std::chrono::duration<double>(afterWarp - afterSequential).count();
+        double conservativeSeconds = std::chrono::duration<double>(end - afterWarp).count();
+        bool identical = optimistic.sameOutcome(sequential) && windowed.sameOutcome(sequential);
+        std::ostringstream ratio;
+        ratio << range[0] << "/" << range[1];
+        std::cout << std::fixed << std::setprecision(2) << std::setw(8) << ratio.str() << std::setw(12) << sequentialSeconds
+            << std::setw(12) << warpSeconds << std::setw(10) << sequentialSeconds / warpSeconds
+            << std::setw(12) << optimistic.rolledBack << std::setw(12) << conservativeSeconds
+            << std::setw(10) << sequentialSeconds / conservativeSeconds << std::setw(10) << windowed.syncRounds
+            << std::setw(11) << (identical ? "yes" : "NO") << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+    std::cout << "===============================" << std::endl;
+}
+
+// Scalar next() against the SSE2 batch fill for both distributions, with
+// std::mt19937_64 plus the standard distributions as a reference point. Checks the
+// two sampler paths agree bit for bit, and how far the polynomial transforms drift
+// from libm on the same uniforms. Returns 1 if the paths disagree.
+int benchmarkSampling() {
+    const size_t count = 4000000;
+    const double low = 4.0;
+    const double high = 15.0;
+    std::vector<double> scalar(count);
+    std::vector<double> batch(count);
+    bool allExact = true;
+    std::cout << "\n===== Clear Time Sampling Benchmark (" << count << " samples, t1 " << low << "s, t2 " << high << "s) =====" << std::endl;
+    std::cout << std::left << std::setw(12) << "dist" << std::right << std::setw(12) << "scalar ns" << std::setw(12) << "batch ns"
+        << std::setw(12) << "std ns" << std::setw(12) << "bit-exact" << std::setw(16) << "vs libm" << std::endl;
+    const ClearTimeDistribution distributions[] = { ClearTimeDistribution::Uniform, ClearTimeDistribution::LogNormal };
+    for (ClearTimeDistribution distribution : distributions) {
+        bool logNormal = distribution == ClearTimeDistribution::LogNormal;
+        ClearTimeSampler scalarSampler(66, distribution, low, high, 0.3);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < count; i++) scalar[i] = scalarSampler.next();
+        auto afterScalar = std::chrono::high_resolution_clock::now();
+        ClearTimeSampler batchSampler(66, distribution, low, high, 0.3);
+        batchSampler.fill(batch.data(), count);
+        auto afterBatch = std::chrono::high_resolution_clock::now();
+
+        std::mt19937_64 gen(66);
+        std::uniform_real_distribution<> uniform(low, high);
+        std::lognormal_distribution<> lognormal(0.5 * (std::log(low) + std::log(high)), 0.3);
+        double sink = 0.0;
+        for (size_t i = 0; i < count; i++) sink += logNormal ? lognormal(gen) : uniform(gen);
+        auto afterStd = std::chrono::high_resolution_clock::now();
+
+        bool exact = std::memcmp(scalar.data(), batch.data(), count * sizeof(double)) == 0;
+        allExact = allExact && exact;
+
+        // Replay the lanes and push the same uniforms through libm
+        double worst = 0.0;
+        ClearTimeSampler replay(66, distribution, low, high, 0.3);
+        for (size_t i = 0; i < count; i++) {
+            int lane = static_cast<int>(i % ClearTimeSampler::lanes);
+            double u1 = ClearTimeSampler::unit(replay.nextBits(lane));
+            double reference = low + (high - low) * u1;
+            if (logNormal) {
+                double u2 = ClearTimeSampler::unit(replay.nextBits(lane));
+                double z = std::sqrt(-2.0 * std::log(1.0 - u1)) * std::cos(6.283185307179586 * u2);
+                reference = std::max(low, std::min(high, std::exp(replay.mu + replay.sigma * z)));
+            }
+            worst = std::max(worst, std::fabs(batch[i] - reference) / reference);
+        }
+
+        auto nanos = [&](std::chrono::high_resolution_clock::time_point from, std::chrono::high_resolution_clock::time_point to) {
+            return std::chrono::duration<double, std::nano>(to - from).count() / count;
+        };
+        std::cout << std::left << std::setw(12) << (logNormal ? "lognormal" : "uniform") << std::right << std::fixed
+            << std::setprecision(2) << std::setw(12) << nanos(start, afterScalar) << std::setw(12) << nanos(afterScalar, afterBatch)
+            << std::setw(12) << nanos(afterBatch, afterStd) << std::setw(12) << (exact ? "yes" : "NO")
+            << std::scientific << std::setprecision(1) << std::setw(16) << worst << (sink < 0 ? " " : "") << std::endl;
+        std::cout.unsetf(std::ios::fixed | std::ios::scientific);
+    }
+    std::cout << "(vs libm: largest relative difference from std::log/cos/exp on the same uniforms)" << std::endl;
+    std::cout << "===============================" << std::endl;
+    if (!allExact) {
+        std::cerr << "Error: scalar and batch clear-time samplers differ; runs are not reproducible across paths." << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// Runs the engine on streaming arrivals until SIGINT/SIGTERM or daemonDuration.
+// The main thread re-renders the SIGUSR1 snapshot once a second. With soakHours > 0
+// this is the memory soak: it runs that many engine hours and fails if RSS after
+// the first fifth of the run grows more than 5% + 2 MB.
+int runDaemon(int tankWeight, int healerWeight, int dpsWeight, int firstPlayerId, double soakHours) {
+    std::signal(SIGINT, handleStopSignal);
+    std::signal(SIGTERM, handleStopSignal);
+#ifndef _WIN32
+    std::signal(SIGUSR1, handleStatsSignal);
+#endif
+    publishStatsSnapshot();
+
+    std::thread managerThread(queueManager);
+    std::thread watcherThread(watchConfig);
+    std::thread arrivalThread;
+    if (arrivalRate > 0 || scenarioLoaded) {
+        arrivalThread = std::thread(generateArrivals, tankWeight, healerWeight, dpsWeight, firstPlayerId);
+    }
+
+    double duration = soakHours > 0 ? soakHours * 3600.0 : daemonDuration;
+    if (soakHours <= 0 && scenarioLoaded && !scenario.repeats && (duration <= 0 || duration > scenario.lengthMs() / 1000.0)) {
+        duration = scenario.lengthMs() / 1000.0;
+    }
+    std::vector<ScenarioAction> steps = scenario.timeline(static_cast<int64_t>(currentConfig()->recoveryTime * 1000));
+    size_t nextStep = 0;
+    int fleet = static_cast<int>(instances.size());
+    int failed = 0;
+    const ScenarioPhase* phase = nullptr;
+    long baselineRss = 0;
+    long peakRss = 0;
+    Clock::time_point nextPublish = Clock::now() + std::chrono::seconds(1);
+    while (!stopRequested && (duration <= 0 || engineSeconds(engineStart, Clock::now()) < duration)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (scenarioLoaded) {
+            int64_t nowMs = static_cast<int64_t>(engineSeconds(engineStart, Clock::now()) * 1000.0);
+            for (; nextStep < steps.size() && steps[nextStep].atMs <= nowMs; nextStep++) {
+                const ScenarioAction& step = steps[nextStep];
+                if (step.kind == SCENARIO_FLEET) {
+                    fleet = step.count;
+                    requestFleetResize(fleet);
+                }
+                else if (step.kind == SCENARIO_FAIL) failed += step.count;
+                else failed -= step.count;
+                instancesOnline = std::max(0, fleet - failed);
+                if (displayMode != DisplayMode::Quiet) {
+                    std::cout << "Scenario " << nowMs / 1000 << "s: " << instancesOnline.load() << " instances online ("
+                        << fleet << " fleet, " << failed << " failed)" << std::endl;
+                }
+            }
+            cv.notify_all();
+            const ScenarioPhase* current = scenario.phaseAt(nowMs);
+            if (current != phase && current != nullptr && displayMode != DisplayMode::Quiet) {
+                std::cout << "Scenario " << nowMs / 1000 << "s: phase " << current->name << ", " << current->rateFrom
+                    << " -> " << current->rateTo << " joins/min" << std::endl;
+            }
+            phase = current;
+        }
+        if (Clock::now() < nextPublish) continue;
+        nextPublish += std::chrono::seconds(1);
+
+        double elapsed = engineSeconds(engineStart, Clock::now());
+        publishStatsSnapshot();
+        if (soakHours > 0) {
+            long rss = currentRssKb();
+            if (elapsed < duration * 0.2) baselineRss = std::max(baselineRss, rss);
+            else peakRss = std::max(peakRss, rss);
+        }
+    }
+
+    // Arrivals stop first so the manager is still running when their last batch lands
+    arrivalsStop = true;
+    if (arrivalThread.joinable()) arrivalThread.join();
+    shutdown = true;
+    queueCv.notify_all();
+    wakeInstanceWaiters();
+    managerThread.join();
+    watcherThread.join();
+
+    publishStatsSnapshot();
+    int index = statsSnapshotIndex.load();
+    std::cout.write(statsSnapshot[index], statsSnapshotLength[index]);
+    std::cout.flush();
+    if (soakHours <= 0) {
+        {
+            std::lock_guard<std::mutex> lock(rollingMutex);
+            hourlyReport.finish(engineSeconds(engineStart, Clock::now()));
+        }
+        printHourlyReport();
+    }
+
+    if (soakHours > 0) {
+        long limit = baselineRss + baselineRss / 20 + 2048;
+        bool passed = peakRss <= limit;
+        std::cout << "Soak: " << soakHours << " engine hours, RSS baseline " << baselineRss << " KB, peak after warm-up "
+            << peakRss << " KB, limit " << limit << " KB: " << (passed ? "PASS" : "FAIL") << std::endl;
+        return passed ? 0 : 1;
+    }
+    return 0;
+}
+
+// A variant is the config.txt settings with comma-separated key=value overrides,
+// e.g. "instance-policy=power-of-two,match-interval=5"; "baseline" changes nothing
+bool parseShadowVariant(const std::string& spec, ShadowVariant& variant) {
+    variant.label = spec;
+    variant.fairness = fairnessPolicy;
+    variant.agingRate = agingRate;
+    variant.instancePolicy = instancePolicy;
+    variant.instances = maxInstances;
+    variant.warmPoolSize = warmPoolSize;
+    variant.matchInterval = 0.0;
+    if (spec == "baseline") return true;
+    std::istringstream fields(spec);
+    std::string field;
+    while (std::getline(fields, field, ',')) {
+        size_t equals = field.find('=');
+        std::string key = field.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : field.substr(equals + 1);
+        if (key == "fairness-policy") variant.fairness = parseFairnessPolicy(value);
+        else if (key == "aging-rate") variant.agingRate = std::atof(value.c_str());
+        else if (key == "instance-policy") variant.instancePolicy = parseInstancePolicy(value);
+        else if (key == "max-num-instances") variant.instances = std::atoi(value.c_str());
+        else if (key == "warm-pool-size") variant.warmPoolSize = std::atoi(value.c_str());
+        else if (key == "match-interval") variant.matchInterval = std::atof(value.c_str());
+        else {
+            std::cerr << "Error: Unknown shadow setting '" << key << "' in " << spec
+                << " (fairness-policy, aging-rate, instance-policy, max-num-instances, warm-pool-size, match-interval)" << std::endl;
+            return false;
+        }
+    }
+    if (variant.instances <= 0 || variant.warmPoolSize < 0 || variant.matchInterval < 0 || variant.agingRate < 0) {
+        std::cerr << "Error: Out-of-range value in shadow variant " << spec << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// The shared stream: Poisson joins at arrival-rate (or ~75% of the configured fleet),
+// shaped by the arrival model when one is set, drawn once from the run's seed
+void generateShadowStream(double hours, int baseInstances, int tankWeight, int healerWeight, int dpsWeight, std::vector<ShadowJoin>& out) {
+    double meanPerSecond = arrivalRate > 0 ? arrivalRate : 0.75 * baseInstances / ((minTime + maxTime) / 2.0) * PARTY_SIZE;
+    Scenario model;
+    bool shaped = arrivalModel != ArrivalModel::Steady && buildArrivalScenario(meanPerSecond, tankWeight, healerWeight, dpsWeight, model);
+    double peakPerSecond = shaped ? model.peakRate() / 60.0 : meanPerSecond;
+    if (peakPerSecond <= 0) return;
+
+    std::mt19937_64 gen(rngSeed ^ 0x5348414457ULL);
+    std::exponential_distribution<> gaps(peakPerSecond);
+    std::uniform_real_distribution<> unit(0.0, 1.0);
+    std::discrete_distribution<> rolePick({ static_cast<double>(tankWeight), static_cast<double>(healerWeight),
+        static_cast<double>(dpsWeight) });
+    double horizon = hours * 3600.0;
+    for (double time = gaps(gen); time < horizon; time += gaps(gen)) {
+        if (!shaped) {
+            out.push_back(ShadowJoin{ time, static_cast<Role>(rolePick(gen)) });
+            continue;
+        }
+        int64_t ms = static_cast<int64_t>(time * 1000.0);
+        const ScenarioPhase* phase = model.phaseAt(ms);
+        if (phase == nullptr || unit(gen) * peakPerSecond * 60.0 >= model.rateAt(ms)) continue;
+        out.push_back(ShadowJoin{ time, scenarioRole(*phase, unit(gen)) });
+    }
+}
+
+bool pinThreadToCore(int core) {
+#ifdef _WIN32
+    return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << (core % 64)) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)core;
+    return false;
+#endif
+}
+
+// Discrete-event engine for one variant. The k-th party formed gets the same
+// dungeon and clear time in every variant, whichever instance it lands on, so
+// variants differ only by what their policies do with them.
+template <typename Selector>
+void runShadowEngine(const ShadowVariant& variant, const std::vector<ShadowJoin>& joins, double horizon, ShadowResult& result) {
+    std::vector<Instance> fleet;
+    for (int i = 0; i < variant.instances; i++) fleet.push_back(Instance(i + 1));
+    WarmPool<Selector> pool(instanceShards);
+    pool.coldStartTime = coldStartTime;
+    pool.mapLoadTime = mapLoadTime;
+    pool.init(dungeonTypes, variant.warmPoolSize);
+    pool.fill(fleet);
+
+    RoleQueue queues[ROLE_COUNT];
+    for (auto& queue : queues) {
+        queue.policy = variant.fairness;
+        queue.agingRate = variant.agingRate;
+    }
+
+    typedef std::pair<double, int> Completion;
+    std::priority_queue<Completion, std::vector<Completion>, std::greater<Completion>> busy;
+    const Clock::time_point epoch = Clock::time_point();
+    size_t nextJoin = 0;
+    double nextMatch = variant.matchInterval;
+    int partyNumber = 1;
+    int nextId = 1;
+    double now = 0.0;
+
+    while (true) {
+        double joinAt = nextJoin < joins.size() ? joins[nextJoin].time : horizon;
+        double doneAt = busy.empty() ? horizon : busy.top().first;
+        double matchAt = variant.matchInterval > 0 ? nextMatch : horizon;
+        now = std::min(joinAt, std::min(doneAt, matchAt));
+        if (now >= horizon) break;
+
+        bool match = variant.matchInterval <= 0;
+        if (doneAt == now) {
+            pool.release(busy.top().second, fleet[busy.top().second]);
+            busy.pop();
+        }
+        else if (joinAt == now) {
+            const ShadowJoin& join = joins[nextJoin++];
+            queues[join.role].push(Player(nextId++, join.role,
+                epoch + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(join.time))));
+        }
+        else {
+            nextMatch += variant.matchInterval;
+            match = true;
+        }
+        if (!match) continue;
+
+        while (queues[TANK].size() >= 1 && queues[HEALER].size() >= 1 && queues[DPS].size() >= 3) {
+            int dungeon = static_cast<int>(runDraws(0, partyNumber, 0, RNG_DUNGEON).v[0] % static_cast<uint32_t>(dungeonTypes));
+            Startup startup;
+            int index = pool.acquire(dungeon, fleet, startup);
+            if (index == -1) break;
+            const Role slots[PARTY_SIZE] = { TANK, HEALER, DPS, DPS, DPS };
+            for (Role role : slots) {
+                Player player = queues[role].pop();
+                result.waits.push_back(now - std::chrono::duration<double>(player.joinTime - epoch).count());
+            }
+            double run = pool.startupCost(startup) + getRandomClearTime(0, partyNumber, 0);
+            fleet[index].partiesServed++;
+            fleet[index].totalTimeServed += std::chrono::seconds(static_cast<long long>(run));
+            result.busySeconds += std::min(run, horizon - now);
+            if (startup == Startup::ColdStart) result.coldStarts++;
+            busy.push(Completion(now + run, index));
+            result.parties++;
+            partyNumber++;
+        }
+    }
+
+    for (auto& queue : queues) {
+        while (queue.size() > 0) {
+            Player player = queue.pop();
+            result.waits.push_back(horizon - std::chrono::duration<double>(player.joinTime - epoch).count());
+            result.stillQueued++;
+        }
+    }
+}
+
+// Thread body: pin, run the variant's engine with its selector, record CPU time
+void runShadowVariant(const ShadowVariant& variant, const std::vector<ShadowJoin>& joins, double horizon, int core, ShadowResult* result) {
+    if (pinThreadToCore(core)) result->core = core;
+    double cpuStart = threadCpuSeconds();
+    switch (variant.instancePolicy) {
+    case InstancePolicy::RoundRobin: runShadowEngine<RoundRobinSelector>(variant, joins, horizon, *result); break;
+    case InstancePolicy::LeastUtilised: runShadowEngine<LeastUtilisedSelector>(variant, joins, horizon, *result); break;
+    case InstancePolicy::MostRecentlyFreed: runShadowEngine<MostRecentlyFreedSelector>(variant, joins, horizon, *result); break;
+    case InstancePolicy::PowerOfTwo: runShadowEngine<PowerOfTwoSelector>(variant, joins, horizon, *result); break;
+    default: runShadowEngine<LowestIndexSelector>(variant, joins, horizon, *result); break;
+    }
+    result->cpuSeconds = threadCpuSeconds() - cpuStart;
+}
+
+// --shadow <variant> <variant> ...: one stream, every variant at once, side by side
+int runShadow(const std::vector<std::string>& specs, int n, int tankWeight, int healerWeight, int dpsWeight) {
+    std::vector<ShadowVariant> variants(specs.size());
+    for (size_t i = 0; i < specs.size(); i++) {
+        if (!parseShadowVariant(specs[i], variants[i])) return 1;
+    }
+    std::vector<ShadowJoin> joins;
+    generateShadowStream(shadowHours, n, tankWeight, healerWeight, dpsWeight, joins);
+    double horizon = shadowHours * 3600.0;
+
+    int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<ShadowResult> results(variants.size());
+    std::vector<std::thread> engines;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < variants.size(); i++) {
+        engines.push_back(std::thread(runShadowVariant, std::cref(variants[i]), std::cref(joins), horizon,
+            static_cast<int>(i) % cores, &results[i]));
+    }
+    for (auto& engine : engines) engine.join();
+    double wall = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    std::cout << "\n===== Shadow Comparison (" << joins.size() << " joins over " << shadowHours << " engine hours, seed "
+        << rngSeed << ") =====" << std::endl;
+    size_t labelWidth = 8;
+    for (const auto& variant : variants) labelWidth = std::max(labelWidth, variant.label.size() + 2);
+    std::cout << std::left << std::setw(static_cast<int>(labelWidth)) << "variant" << std::right << std::setw(10) << "parties"
+        << std::setw(11) << "parties/h" << std::setw(10) << "wait p50" << std::setw(10) << "wait p95" << std::setw(10) << "wait p99"
+        << std::setw(10) << "wait max" << std::setw(8) << "util%" << std::setw(8) << "cold%" << std::setw(8) << "queued"
+        << std::setw(8) << "cpu s" << std::setw(6) << "core" << std::endl;
+    for (size_t i = 0; i < variants.size(); i++) {
+        const ShadowResult& result = results[i];
+        std::cout << std::left << std::setw(static_cast<int>(labelWidth)) << variants[i].label << std::right << std::fixed
+            << std::setprecision(0) << std::setw(10) << result.parties << std::setw(11) << result.parties / shadowHours
+            << std::setprecision(1) << std::setw(10) << percentile(result.waits, 0.5) << std::setw(10) << percentile(result.waits, 0.95)
+            << std::setw(10) << percentile(result.waits, 0.99) << std::setw(10) << percentile(result.waits, 1.0)
+            << std::setw(8) << 100.0 * result.busySeconds / (variants[i].instances * horizon)
+            << std::setw(8) << (result.parties > 0 ? 100.0 * result.coldStarts / result.parties : 0.0)
+            << std::setw(8) << result.stillQueued << std::setprecision(2) << std::setw(8) << result.cpuSeconds
+            << std::setw(6) << (result.core >= 0 ? std::to_string(result.core) : "-") << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+    std::cout << "(same joins, dungeons and k-th party clear times in every variant; waits in engine seconds; "
+        << std::fixed << std::setprecision(2) << wall << "s wall)" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << "===============================" << std::endl;
+    return 0;
+}
+
+// A tenant's engine for one selector type. Arrivals, dungeons and clear times come
+// from Philox blocks keyed by the tenant's number, so a tenant needs no generator
+// state and replays the same way whatever the host's scheduling does to it. Each
+// event is handled at its own due time; lateness only shows up in the lag stats.
+template <typename Selector>
+class TenantEngine : public Tenant {
+public:
+    TenantEngine(int tenantNumber, const TenantSpec& tenantSpec)
+        : number(static_cast<uint32_t>(tenantNumber)), pool(tenantSpec.instanceShards) {
+        spec = tenantSpec;
+        for (int i = 0; i < spec.config.instances; i++) fleet.push_back(Instance(i + 1));
+        pool.coldStartTime = spec.coldStartTime;
+        pool.mapLoadTime = spec.mapLoadTime;
+        pool.init(spec.dungeonTypes, spec.warmPoolSize);
+        pool.fill(fleet);
+        for (auto& queue : queues) {
+            queue.policy = spec.config.fairness;
+            queue.agingRate = spec.config.agingRate;
+        }
+        nextArrival = arrivalGap();
+    }
+
+    bool step(double now, Clock::time_point sliceEnd) override {
+        int handled = 0;
+        while (true) {
+            double doneAt = busy.empty() ? HUGE_VAL : busy.top().first;
+            double at = std::min(nextArrival, doneAt);
+            if (at > now) return false;
+            if (++handled % 32 == 0 && Clock::now() >= sliceEnd) return true;
+
+            stats.lagBuckets[log2Bucket(now - at)]++;
+            stats.lagMax = std::max(stats.lagMax, now - at);
+            if (doneAt <= nextArrival) {
+                pool.release(busy.top().second, fleet[busy.top().second]);
+                busy.pop();
+            }
+            else {
+                Philox4x32 draws(rngSeed, number, arrivals, 1, RNG_ARRIVAL);
+                const double* weights = spec.roleWeights;
+                double pick = draws.uniform(0) * (weights[TANK] + weights[HEALER] + weights[DPS]);
+                Role role = pick < weights[TANK] ? TANK : pick < weights[TANK] + weights[HEALER] ? HEALER : DPS;
+                queues[role].push(Player(nextId++, role, epoch + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(at))));
+                stats.joins++;
+                nextArrival = at + arrivalGap();
+            }
+            match(at);
+        }
+    }
+
+    double nextDue() const override {
+        return busy.empty() ? nextArrival : std::min(nextArrival, busy.top().first);
+    }
+
+    long long queued() const override {
+        return static_cast<long long>(queues[TANK].size() + queues[HEALER].size() + queues[DPS].size());
+    }
+
+private:
+    typedef std::pair<double, int> Completion;
+    uint32_t number;
+    std::vector<Instance> fleet;
+    WarmPool<Selector> pool;
+    RoleQueue queues[ROLE_COUNT];
+    std::priority_queue<Completion, std::vector<Completion>, std::greater<Completion>> busy;
+    const Clock::time_point epoch = Clock::time_point();
+    double nextArrival = 0.0;
+    uint32_t arrivals = 0;
+    uint32_t partyNumber = 1;
+    int nextId = 1;
+
+    // Exponential gap at the tenant's arrival rate, from the next arrival's block
+    double arrivalGap() {
+        Philox4x32 draws(rngSeed, number, arrivals++, 0, RNG_ARRIVAL);
+        return -std::log(1.0 - draws.uniform(0)) / spec.config.arrivalRate;
+    }
+
+    void match(double now) {
+        while (queues[TANK].size() >= 1 && queues[HEALER].size() >= 1 && queues[DPS].size() >= 3) {
+            Philox4x32 party(rngSeed, number, partyNumber, 0, RNG_DUNGEON);
+            Startup startup;
+            int index = pool.acquire(static_cast<int>(party.v[0] % static_cast<uint32_t>(spec.dungeonTypes)), fleet, startup);
+            if (index == -1) return;
+            const Role slots[PARTY_SIZE] = { TANK, HEALER, DPS, DPS, DPS };
+            for (Role role : slots) {
+                Player player = queues[role].pop();
+                double wait = now - std::chrono::duration<double>(player.joinTime - epoch).count();
+                stats.waitBuckets[log2Bucket(wait)]++;
+                stats.waitMax = std::max(stats.waitMax, wait);
+            }
+            double run = pool.startupCost(startup) + clearTimeFrom(spec.config, Philox4x32(rngSeed, number, partyNumber, 0, RNG_CLEAR_TIME));
+            fleet[index].partiesServed++;
+            stats.busySeconds += run;
+            stats.parties++;
+            busy.push(Completion(now + run, index));
+            partyNumber++;
+        }
+    }
+};
+
+Tenant* makeTenant(int number, const TenantSpec& spec) {
+    switch (spec.config.instancePolicy) {
+    case InstancePolicy::RoundRobin: return new TenantEngine<RoundRobinSelector>(number, spec);
+    case InstancePolicy::LeastUtilised: return new TenantEngine<LeastUtilisedSelector>(number, spec);
+    case InstancePolicy::MostRecentlyFreed: return new TenantEngine<MostRecentlyFreedSelector>(number, spec);
+    case InstancePolicy::PowerOfTwo: return new TenantEngine<PowerOfTwoSelector>(number, spec);
+    default: return new TenantEngine<LowestIndexSelector>(number, spec);
+    }
+}
+
+// Tenants file, one line per tenant: <name>[*copies] [config-file|-] [key=value ...].
+// A tenant starts from the host's config.txt values, then its own config file, then
+// the overrides, all read by the same validation as a live reload. On top of the live
+// keys a tenant takes num-tank/num-healer/num-dps as role weights, warm-pool-size,
+// instance-shards, dungeon-types, cold-start-time, map-load-time and cpu-share. name*N adds N copies named name-0 .. name-(N-1).
+bool loadTenants(const std::string& path, const EngineConfig& base, int tankWeight, int healerWeight, int dpsWeight,
+    std::vector<std::unique_ptr<Tenant>>& out) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open tenants file " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string name;
+        if (!(fields >> name)) continue;
+
+        std::string text;
+        std::string field;
+        while (fields >> field) {
+            size_t equals = field.find('=');
+            if (equals != std::string::npos) {
+                text += "\n" + field.substr(0, equals) + " " + field.substr(equals + 1);
+            }
+            else if (field != "-") {
+                std::ifstream configFile(field);
+                if (!configFile.is_open()) {
+                    std::cerr << "Error: Could not open " << field << " for tenant " << name << std::endl;
+                    return false;
+                }
+                std::ostringstream contents;
+                contents << configFile.rdbuf();
+                text = contents.str() + text;
+            }
+        }
+
+        TenantSpec spec;
+        spec.config = base;
+        spec.roleWeights[TANK] = tankWeight;
+        spec.roleWeights[HEALER] = healerWeight;
+        spec.roleWeights[DPS] = dpsWeight;
+        spec.warmPoolSize = warmPoolSize;
+        spec.instanceShards = instanceShards;
+        spec.dungeonTypes = dungeonTypes;
+        spec.coldStartTime = coldStartTime;
+        spec.mapLoadTime = mapLoadTime;
+        std::istringstream liveText(text);
+        std::string error;
+        bool ok = parseLiveConfig(liveText, spec.config, error);
+        std::istringstream tenantText(text);
+        std::string entry;
+        while (ok && std::getline(tenantText, entry)) {
+            std::istringstream iss(entry);
+            std::string key;
+            iss >> key;
+            if (key == "num-tank") ok = (iss >> spec.roleWeights[TANK]) && spec.roleWeights[TANK] > 0;
+            else if (key == "num-healer") ok = (iss >> spec.roleWeights[HEALER]) && spec.roleWeights[HEALER] > 0;
+            else if (key == "num-dps") ok = (iss >> spec.roleWeights[DPS]) && spec.roleWeights[DPS] > 0;
+            else if (key == "warm-pool-size") ok = (iss >> spec.warmPoolSize) && spec.warmPoolSize >= 0;
+            else if (key == "instance-shards") ok = (iss >> spec.instanceShards) && spec.instanceShards > 0;
+            else if (key == "dungeon-types") ok = (iss >> spec.dungeonTypes) && spec.dungeonTypes > 0;
+            else if (key == "cold-start-time") ok = (iss >> spec.coldStartTime) && spec.coldStartTime >= 0;
+            else if (key == "map-load-time") ok = (iss >> spec.mapLoadTime) && spec.mapLoadTime >= 0;
+            else if (key == "cpu-share") ok = (iss >> spec.cpuShare) && spec.cpuShare > 0;
+            if (!ok) error = "invalid value for " + key;
+        }
+        if (!ok) {
+            std::cerr << "Error: Tenant " << name << " on line " << lineNumber << " of " << path << ": " << error << std::endl;
+            return false;
+        }
+        // Same default as the daemon: about 75% of what the tenant's fleet clears
+        if (spec.config.arrivalRate <= 0) {
+            spec.config.arrivalRate = 0.75 * spec.config.instances / ((spec.config.minTime + spec.config.maxTime) / 2.0) * PARTY_SIZE;
+        }
+
+        int copies = 1;
+        size_t star = name.find('*');
+        if (star != std::string::npos) {
+            copies = std::atoi(name.c_str() + star + 1);
+            name = name.substr(0, star);
+            if (copies <= 0) {
+                std::cerr << "Error: Bad copy count for tenant " << name << " on line " << lineNumber << " of " << path << std::endl;
+                return false;
+            }
+        }
+        for (int copy = 0; copy < copies; copy++) {
+            spec.name = star == std::string::npos ? name : name + "-" + std::to_string(copy);
+            out.push_back(std::unique_ptr<Tenant>(makeTenant(static_cast<int>(out.size()), spec)));
+        }
+    }
+    if (out.empty()) {
+        std::cerr << "Error: No tenants in " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Worker loop: wake tenants whose next event has come due, run the due tenant with
+// the lowest virtual runtime for up to one quantum, charge it the CPU it used and
+// put it back. A tenant that wakes from sleep starts no lower than the host minimum,
+// so idling banks no credit, and a busy tenant that keeps using its quantum falls
+// behind every tenant with less CPU per share, which is what keeps it from starving them.
+void runHostWorker(TenantHost* host, double* cpuSeconds) {
+    double cpuStart = threadCpuSeconds();
+    std::unique_lock<std::mutex> lock(host->mutex);
+    while (!host->stop) {
+        double now = engineSeconds(host->start, Clock::now());
+        while (!host->sleeping.empty() && host->sleeping.top().first <= now) {
+            Tenant& waking = *host->tenants[host->sleeping.top().second];
+            waking.virtualRuntime = std::max(waking.virtualRuntime, host->minVirtualRuntime);
+            host->ready.push(TenantHost::Entry(waking.virtualRuntime, host->sleeping.top().second));
+            host->sleeping.pop();
+        }
+        if (host->ready.empty()) {
+            if (host->sleeping.empty()) host->wake.wait(lock);
+            else {
+                host->wake.wait_until(lock, host->start + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(host->sleeping.top().first * timeScale)));
+            }
+            continue;
+        }
+        int index = host->ready.top().second;
+        host->ready.pop();
+        Tenant& tenant = *host->tenants[index];
+        host->minVirtualRuntime = std::max(host->minVirtualRuntime, tenant.virtualRuntime);
+        lock.unlock();
+
+        double sliceStart = threadCpuSeconds();
+        bool backlog = tenant.step(now, Clock::now() + host->quantum);
+        double used = threadCpuSeconds() - sliceStart;
+
+        lock.lock();
+        tenant.stats.cpuSeconds += used;
+        tenant.stats.slices++;
+        if (backlog) tenant.stats.preempted++;
+        tenant.virtualRuntime += used / tenant.spec.cpuShare;
+        if (backlog) {
+            host->ready.push(TenantHost::Entry(tenant.virtualRuntime, index));
+        }
+        else {
+            double due = tenant.nextDue();
+            bool earliest = host->sleeping.empty() || due < host->sleeping.top().first;
+            host->sleeping.push(TenantHost::Entry(due, index));
+            if (earliest) host->wake.notify_one();
+        }
+    }
+    *cpuSeconds = threadCpuSeconds() - cpuStart;
+}
+
+// --host <tenants-file>: every tenant in one process on hostThreads shared workers,
+// until SIGINT/SIGTERM or daemon-duration engine seconds, then per-tenant stats
+int runHost(const std::string& tenantsPath, int tankWeight, int healerWeight, int dpsWeight) {
+    TenantHost host;
+    long rssBefore = currentRssKb();
+    if (!loadTenants(tenantsPath, currentConfig() ? *currentConfig() : configFromGlobals(), tankWeight, healerWeight, dpsWeight, host.tenants)) return 1;
+    long rssTenants = currentRssKb() - rssBefore;
+    int workers = hostThreads > 0 ? hostThreads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    host.quantum = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(hostQuantum));
+    for (size_t i = 0; i < host.tenants.size(); i++) {
+        host.sleeping.push(TenantHost::Entry(host.tenants[i]->nextDue(), static_cast<int>(i)));
+    }
+
+    std::signal(SIGINT, handleStopSignal);
+    std::signal(SIGTERM, handleStopSignal);
+    std::cout << "Hosting " << host.tenants.size() << " tenants on " << workers << " workers (quantum " << hostQuantum * 1000.0
+        << " ms, time-scale " << timeScale << ")";
+    if (daemonDuration > 0) std::cout << " for " << daemonDuration << " engine seconds";
+    std::cout << ", seed " << rngSeed << std::endl;
+
+    host.start = Clock::now();
+    std::vector<double> workerCpu(workers, 0.0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < workers; i++) threads.push_back(std::thread(runHostWorker, &host, &workerCpu[i]));
+    while (!stopRequested && (daemonDuration <= 0 || engineSeconds(host.start, Clock::now()) < daemonDuration)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    {
+        std::lock_guard<std::mutex> lock(host.mutex);
+        host.stop = true;
+    }
+    host.wake.notify_all();
+    for (auto& thread : threads) thread.join();
+    double wall = std::chrono::duration<double>(Clock::now() - host.start).count();
+    double elapsed = engineSeconds(host.start, Clock::now());
+
+    double totalCpu = 0.0;
+    for (double cpu : workerCpu) totalCpu += cpu;
+    double tenantCpu = 0.0;
+    long long parties = 0;
+    uint64_t waits[32] = {};
+    uint64_t lags[32] = {};
+    std::vector<Tenant*> order;
+    for (auto& tenant : host.tenants) {
+        order.push_back(tenant.get());
+        tenantCpu += tenant->stats.cpuSeconds;
+        parties += tenant->stats.parties;
+        for (int b = 0; b < 32; b++) {
+            waits[b] += tenant->stats.waitBuckets[b];
+            lags[b] += tenant->stats.lagBuckets[b];
+        }
+    }
+    std::sort(order.begin(), order.end(), [](const Tenant* a, const Tenant* b) { return a->stats.cpuSeconds > b->stats.cpuSeconds; });
+
+    const size_t shown = 20;
+    std::cout << "\n===== Tenant Host (" << host.tenants.size() << " tenants, " << workers << " workers, " << std::fixed
+        << std::setprecision(0) << elapsed << " engine s) =====" << std::endl;
+    size_t nameWidth = 8;
+    for (size_t i = 0; i < order.size() && i < shown; i++) nameWidth = std::max(nameWidth, order[i]->spec.name.size() + 2);
+    std::cout << std::left << std::setw(static_cast<int>(nameWidth)) << "tenant" << std::right << std::setw(6) << "share"
+        << std::setw(7) << "inst" << std::setw(11) << "joins" << std::setw(10) << "parties" << std::setw(10) << "queued"
+        << std::setw(10) << "wait p50" << std::setw(10) << "wait p99" << std::setw(7) << "util%" << std::setw(10) << "lag p99"
+        << std::setw(9) << "lag max" << std::setw(9) << "cpu ms" << std::setw(7) << "cpu%" << std::setw(9) << "slices"
+        << std::setw(7) << "cut" << std::endl;
+    for (size_t i = 0; i < order.size() && i < shown; i++) {
+        const Tenant& tenant = *order[i];
+        const TenantStats& stats = tenant.stats;
+        std::cout << std::left << std::setw(static_cast<int>(nameWidth)) << tenant.spec.name << std::right << std::setprecision(1)
+            << std::setw(6) << tenant.spec.cpuShare << std::setw(7) << tenant.spec.config.instances << std::setw(11) << stats.joins
+            << std::setw(10) << stats.parties << std::setw(10) << tenant.queued()
+            << std::setw(10) << std::min(bucketPercentile(stats.waitBuckets, 0.5), stats.waitMax)
+            << std::setw(10) << std::min(bucketPercentile(stats.waitBuckets, 0.99), stats.waitMax)
+            << std::setw(7) << (elapsed > 0 ? 100.0 * std::min(stats.busySeconds / (tenant.spec.config.instances * elapsed), 1.0) : 0.0)
+            << std::setprecision(3) << std::setw(10) << std::min(bucketPercentile(stats.lagBuckets, 0.99), stats.lagMax) << std::setw(9) << stats.lagMax
+            << std::setprecision(1) << std::setw(9) << stats.cpuSeconds * 1000.0
+            << std::setw(7) << (tenantCpu > 0 ? 100.0 * stats.cpuSeconds / tenantCpu : 0.0)
+            << std::setw(9) << stats.slices << std::setw(7) << stats.preempted << std::endl;
+    }
+    if (order.size() > shown) std::cout << "... " << order.size() - shown << " more tenants, all under " << std::setprecision(1)
+        << order[shown - 1]->stats.cpuSeconds * 1000.0 << " cpu ms" << std::endl;
+    std::cout << std::setprecision(3) << "All tenants: " << parties << " parties, wait p99 " << bucketPercentile(waits, 0.99)
+        << "s, lag p99 " << bucketPercentile(lags, 0.99) << "s (waits and lag in engine seconds)" << std::endl;
+    std::cout << std::setprecision(2) << "Workers: " << totalCpu << " cpu s over " << wall << "s wall ("
+        << 100.0 * totalCpu / (wall * workers) << "% of " << workers << " cores), " << tenantCpu << " cpu s inside tenants" << std::endl;
+    std::cout << "Tenant memory: " << rssTenants << " KB RSS for " << host.tenants.size() << " tenants ("
+        << static_cast<double>(rssTenants) / host.tenants.size() << " KB each)" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << "===============================" << std::endl;
+    return 0;
+}
+
+// Per engine hour: what arrived, what got through, and how long it waited
+void printHourlyReport() {
+    std::lock_guard<std::mutex> lock(rollingMutex);
+    if (hourlyReport.hours.empty()) return;
+    std::cout << "\n===== Hourly Report =====" << std::endl;
+    std::cout << std::left << std::setw(6) << "hour" << std::right << std::setw(10) << "joins" << std::setw(8) << "tank%"
+        << std::setw(9) << "healer%" << std::setw(10) << "parties" << std::setw(12) << "parties/min" << std::setw(10) << "wait avg"
+        << std::setw(10) << "wait p99" << std::setw(10) << "wait max" << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    size_t worst = 0;
+    double worstWait = -1.0;
+    for (size_t h = 0; h < hourlyReport.hours.size(); h++) {
+        const HourlyReport::Hour& hour = hourlyReport.hours[h];
+        uint64_t joins = hour.joins[TANK] + hour.joins[HEALER] + hour.joins[DPS];
+        double p99 = std::min(RollingWindow::histogramPercentile(hour.histogram, hour.waits, 0.99), hour.waitMax);
+        std::ostringstream label;
+        label << std::setw(2) << std::setfill('0') << h % 24 << ":00";
+        std::cout << std::left << std::setw(6) << label.str() << std::right << std::setw(10) << joins
+            << std::setw(8) << (joins > 0 ? 100.0 * hour.joins[TANK] / joins : 0.0)
+            << std::setw(9) << (joins > 0 ? 100.0 * hour.joins[HEALER] / joins : 0.0)
+            << std::setw(10) << hour.parties << std::setw(12) << (hour.minutes > 0 ? hour.parties / hour.minutes : 0.0)
+            << std::setw(10) << (hour.waits > 0 ? hour.waitSum / hour.waits : 0.0) << std::setw(10) << p99
+            << std::setw(10) << hour.waitMax << std::endl;
+        if (hour.waits > 0 && hour.waitSum / hour.waits > worstWait) {
+            worstWait = hour.waitSum / hour.waits;
+            worst = h;
+        }
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << "Worst hour by mean wait: " << std::setw(2) << std::setfill('0') << worst % 24 << ":00" << std::setfill(' ') << std::endl;
+    std::cout << "===============================" << std::endl;
+}
+
+// Caller holds queueMutex
+void publishRoleDepths() {
+    liveStats.roleDepth[TANK].store(tanksAvailable, std::memory_order_relaxed);
+    liveStats.roleDepth[HEALER].store(healersAvailable, std::memory_order_relaxed);
+    liveStats.roleDepth[DPS].store(dpsAvailable, std::memory_order_relaxed);
+}
+
+double threadCpuSeconds() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) return 0.0;
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 1e7;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+// Builds one frame from the live counters: instance heatmap (state, shaded by runs
+// completed), role depths, a one-minute completions/s sparkline and wait percentiles.
+std::string renderDashboard(const std::vector<uint64_t>& throughputHistory) {
+    static const char shades[] = " .:-=+*#%@";
+    std::ostringstream frame;
+    frame << "\x1b[H\x1b[2J"; // home and clear
+    frame << "===== LFG Dungeon Dashboard =====\n\n";
+
+    uint32_t mostRuns = 1;
+    int instanceCount = liveStats.instanceCount.load(std::memory_order_relaxed);
+    for (int i = 0; i < instanceCount; i++) {
+        mostRuns = std::max(mostRuns, liveStats.instanceRuns[i].load(std::memory_order_relaxed));
+    }
+    frame << "Instances (" << instanceCount << ")  \x1b[42m busy \x1b[0m \x1b[43m starting \x1b[0m "
+        << "\x1b[41m recovering \x1b[0m idle shaded by runs completed\n";
+    for (int i = 0; i < instanceCount; i++) {
+        uint8_t state = liveStats.instanceState[i].load(std::memory_order_relaxed);
+        uint32_t runs = liveStats.instanceRuns[i].load(std::memory_order_relaxed);
+        char shade = shades[runs * 9 / mostRuns];
+        if (state == INSTANCE_BUSY) frame << "\x1b[42m" << shade << "\x1b[0m";
+        else if (state == INSTANCE_STARTING) frame << "\x1b[43m" << shade << "\x1b[0m";
+        else if (state == INSTANCE_RECOVERING) frame << "\x1b[41m" << shade << "\x1b[0m";
+        else frame << shade;
+        if (i % 64 == 63) frame << "\n";
+    }
+    frame << "\n\nQueue depth  tanks " << liveStats.roleDepth[TANK].load(std::memory_order_relaxed)
+        << "  healers " << liveStats.roleDepth[HEALER].load(std::memory_order_relaxed)
+        << "  dps " << liveStats.roleDepth[DPS].load(std::memory_order_relaxed) << "\n";
+
+    uint64_t peak = 1;
+    for (uint64_t sample : throughputHistory) peak = std::max(peak, sample);
+    frame << "Completions/s [";
+    for (uint64_t sample : throughputHistory) frame << shades[sample * 9 / peak];
+    frame << "] last " << (throughputHistory.empty() ? 0 : throughputHistory.back()) << ", peak " << peak << "\n";
+
+    frame << std::fixed << std::setprecision(3) << "Queue wait   p50 <" << liveStats.waitPercentile(0.5)
+        << "s  p95 <" << liveStats.waitPercentile(0.95) << "s  p99 <" << liveStats.waitPercentile(0.99) << "s\n";
+    frame << "Completed    " << liveStats.completions.load(std::memory_order_relaxed) << " parties\n";
+    return frame.str();
+}
+
+// Redraws at dashboardFps until dashboardStop, sampling completions once a second
+// for the sparkline. Reports its own CPU time so its overhead can be checked.
+void runDashboard(double* cpuSeconds, int* frames) {
+    const auto frameInterval = std::chrono::microseconds(1000000 / dashboardFps);
+    std::vector<uint64_t> throughputHistory;
+    uint64_t lastCompletions = 0;
+    Clock::time_point nextSample = Clock::now() + std::chrono::seconds(1);
+    Clock::time_point nextFrame = Clock::now();
+    double cpuStart = threadCpuSeconds();
+    *frames = 0;
+
+    while (true) {
+        bool stopping = dashboardStop.load();
+        if (Clock::now() >= nextSample || stopping) {
+            uint64_t completions = liveStats.completions.load(std::memory_order_relaxed);
+            throughputHistory.push_back(completions - lastCompletions);
+            if (throughputHistory.size() > 60) throughputHistory.erase(throughputHistory.begin());
+            lastCompletions = completions;
+            nextSample += std::chrono::seconds(1);
+        }
+
+        std::string frame = renderDashboard(throughputHistory);
+        std::cout.write(frame.data(), frame.size());
+        std::cout.flush();
+        (*frames)++;
+        if (stopping) break;
+
+        nextFrame += frameInterval;
+        std::this_thread::sleep_until(nextFrame);
+    }
+    *cpuSeconds = threadCpuSeconds() - cpuStart;
+}
+
+// Writes out logBuffer every LOG_FLUSH_MS until logStop, draining it once more on
+// the way out, so the status block is printed per batch rather than per entry
+void runLogWriter() {
+    std::string text;
+    while (true) {
+        bool stopping = logStop.load();
+        bool statusDue = logBuffer.take(text);
+        if (!text.empty()) {
+            std::cout.write(text.data(), text.size());
+            std::cout.flush();
+        }
+        if (statusDue) displayStatus();
+        if (stopping) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(LOG_FLUSH_MS));
+    }
+}
+
+void recordEvent(EventType type, int subject, int instance, int value) {
+    if (eventExporter == nullptr) return;
+    EngineEvent event;
+    event.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - engineStart).count();
+    event.type = type;
+    event.subject = subject;
+    event.instance = instance;
+    event.value = value;
+    eventExporter->record(event);
+}
+
+void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+size_t countByte(const uint8_t* data, size_t size, uint8_t value) {
+    size_t count = 0;
+    size_t i = 0;
+#ifdef LFG_HAVE_SSE2
+    const __m128i needle = _mm_set1_epi8(static_cast<char>(value));
+    for (; i + 16 <= size; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, needle));
+        while (mask) {
+            count++;
+            mask &= mask - 1;
+        }
+    }
+#endif
+    for (; i < size; i++) {
+        if (data[i] == value) count++;
+    }
+    return count;
+}
+
+// Decodes `count` varints and returns the bytes consumed, or 0 if the column is
+// truncated. Runs of 16 single-byte varints (no continuation bits) are taken at
+// once; small deltas make those runs the common case.
+size_t decodeVarints(const uint8_t* data, size_t size, uint64_t* out, size_t count) {
+    size_t pos = 0;
+    size_t n = 0;
+    while (n < count) {
+#ifdef LFG_HAVE_SSE2
+        if (pos + 16 <= size && n + 16 <= count) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+            if (_mm_movemask_epi8(bytes) == 0) {
+                for (int k = 0; k < 16; k++) out[n + k] = data[pos + k];
+                pos += 16;
+                n += 16;
+                continue;
+            }
+        }
+#endif
+        uint64_t value = 0;
+        int shift = 0;
+        while (true) {
+            if (pos >= size || shift > 63) return 0;
+            uint8_t byte = data[pos++];
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) break;
+            shift += 7;
+        }
+        out[n++] = value;
+    }
+    return pos;
+}
+
+// Offline reader for the event log: counts events by type straight off the type
+// column and decodes the time and value columns for span and clear-time stats.
+void readEventLog(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "Error: Could not open event log " << path << std::endl;
+        return;
+    }
+    std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (file.size() < sizeof(eventLogMagic) || !std::equal(eventLogMagic, eventLogMagic + sizeof(eventLogMagic), file.begin())) {
+        std::cerr << "Error: " << path << " is not an event log" << std::endl;
+        return;
+    }
+
+    auto scanStart = std::chrono::high_resolution_clock::now();
+    size_t pos = sizeof(eventLogMagic);
+    auto readU32 = [&](uint32_t& value) {
+        if (pos + 4 > file.size()) return false;
+        value = file[pos] | (file[pos + 1] << 8) | (file[pos + 2] << 16) | (static_cast<uint32_t>(file[pos + 3]) << 24);
+        pos += 4;
+        return true;
+    };
+
+    long long totalEvents = 0;
+    long long chunks = 0;
+    long long typeCounts[eventTypeCount] = {};
+    int64_t firstTime = -1;
+    int64_t lastTime = 0;
+    long long clearMsTotal = 0;
+    std::vector<uint64_t> decoded;
+
+    uint32_t count;
+    while (readU32(count)) {
+        const uint8_t* columns[5];
+        uint32_t lengths[5];
+        for (int c = 0; c < 5; c++) {
+            if (!readU32(lengths[c]) || pos + lengths[c] > file.size()) {
+                std::cerr << "Error: Truncated chunk in " << path << std::endl;
+                return;
             }
+            columns[c] = file.data() + pos;
+            pos += lengths[c];
         }
-        else if (key == "num-healer") {
-            iss >> *h;
-            if (*h <= 0) {
-                std::cerr << "Warning: Invalid value for num-healer in config file. Must be > 0." << std::endl;
-                *h = 0; 
-            }
+        if (lengths[1] != count) {
+            std::cerr << "Error: Corrupt type column in " << path << std::endl;
+            return;
         }
-        else if (key == "num-dps") {
-            iss >> *d;
-            if (*d <= 0) {
-                std::cerr << "Warning: Invalid value for num-dps in config file. Must be > 0." << std::endl;
-                *d = 0; 
-            }
+
+        for (int type = 0; type < eventTypeCount; type++) {
+            typeCounts[type] += countByte(columns[1], count, static_cast<uint8_t>(type));
         }
-        else if (key == "min-time") {
-            iss >> *t1;
-            if (*t1 <= 0) {
-                std::cerr << "Warning: Invalid value for min-time in config file. Must be > 0." << std::endl;
-                *t1 = 0; 
-            }
+
+        decoded.resize(count);
+        if (decodeVarints(columns[0], lengths[0], decoded.data(), count) == 0 && count > 0) {
+            std::cerr << "Error: Corrupt time column in " << path << std::endl;
+            return;
         }
-        else if (key == "max-time") {
-            iss >> *t2;
+        int64_t time = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            time += unzigzag(decoded[i]);
+            if (firstTime < 0) firstTime = time;
         }
-    }
+        lastTime = std::max(lastTime, time);
 
-    if (*t1 >= *t2 && *t1 > 0 && *t2 > 0) {
-        std::cerr << "Warning: min-time must be less than max-time in config file." << std::endl;
-        *t2 = 0; 
+        if (decodeVarints(columns[4], lengths[4], decoded.data(), count) == 0 && count > 0) {
+            std::cerr << "Error: Corrupt value column in " << path << std::endl;
+            return;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            if (columns[1][i] == static_cast<uint8_t>(EventType::Complete)) clearMsTotal += unzigzag(decoded[i]);
+        }
+
+        totalEvents += count;
+        chunks++;
     }
+    std::chrono::duration<double> scanTime = std::chrono::high_resolution_clock::now() - scanStart;
 
-    // Close the file
-    configFile.close();
+    std::cout << "\n===== Event Log " << path << " =====" << std::endl;
+    std::cout << "Events: " << totalEvents << " in " << chunks << " chunks, " << file.size() << " bytes ("
+        << std::fixed << std::setprecision(2) << (totalEvents > 0 ? static_cast<double>(file.size()) / totalEvents : 0.0)
+        << " bytes/event)" << std::endl;
+    for (int type = 0; type < eventTypeCount; type++) {
+        std::cout << "  " << std::left << std::setw(10) << eventTypeNames[type] << std::right << typeCounts[type] << std::endl;
+    }
+    if (totalEvents > 0) {
+        std::cout << "Time span: " << std::setprecision(3) << (lastTime - firstTime) / 1e9 << "s" << std::endl;
+    }
+    long long completed = typeCounts[static_cast<int>(EventType::Complete)];
+    if (completed > 0) {
+        std::cout << "Mean clear time: " << std::setprecision(2) << clearMsTotal / 1000.0 / completed << "s" << std::endl;
+    }
+    std::cout << "Scanned in " << std::setprecision(3) << scanTime.count() * 1000 << " ms ("
+        << std::setprecision(0) << (scanTime.count() > 0 ? totalEvents / scanTime.count() : 0.0) << " events/s)" << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << "===============================" << std::endl;
 }
 
-int getRandomClearTime() {
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dist(minTime, maxTime);
-    return dist(gen);
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
 }
 
-bool canFormParty() {
-    std::lock_guard<std::mutex> lock(queueMutex);
-    return (tanksAvailable >= 1 && healersAvailable >= 1 && dpsAvailable >= 3);
+// (sum x)^2 / (n * sum x^2): 1.0 when everyone waits equally long, 1/n when one player does all the waiting
+double jainIndex(const std::vector<double>& values) {
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    for (double v : values) {
+        sum += v;
+        sumSquares += v * v;
+    }
+    if (values.empty() || sumSquares == 0.0) return 1.0;
+    return (sum * sum) / (values.size() * sumSquares);
 }
 
-int maxPossibleParties() {
-    std::lock_guard<std::mutex> lock(queueMutex);
-    return std::min({ tanksAvailable, healersAvailable, dpsAvailable / 3 });
-}
+// Feeds a DPS-heavy arrival stream into each policy on a virtual clock with a fixed
+// number of party slots per tick, then reports wait fairness and matcher throughput.
+void benchmarkFairness() {
+    const int ticks = 20000;            // one virtual second each
+    const int partiesPerTick = 2;
+    const double boostedShare = 0.1;    // players carrying a priority boost
+    const double boostSeconds = 30.0;
+    const FairnessPolicy policies[] = { FairnessPolicy::Legacy, FairnessPolicy::StrictFifo, FairnessPolicy::Aging };
 
-void formParty() {
-    std::lock_guard<std::mutex> lock(queueMutex);
-    tanksAvailable -= 1;
-    healersAvailable -= 1;
-    dpsAvailable -= 3;
-}
+    std::cout << "\n===== Fairness Benchmark =====" << std::endl;
+    std::cout << std::left << std::setw(8) << "policy"
+        << std::right << std::setw(12) << "max wait" << std::setw(12) << "p99 wait"
+        << std::setw(12) << "dps max" << std::setw(10) << "jain"
+        << std::setw(16) << "parties/sec" << std::endl;
 
-int findAvailableInstance() {
-    std::lock_guard<std::mutex> lock(instancesMutex);
-    for (int i = 0; i < instances.size(); i++) {
-        if (!instances[i].active) {
-            return i;
+    for (FairnessPolicy policy : policies) {
+        std::mt19937 gen(12345); // same arrivals for every policy
+        std::poisson_distribution<> tankArrivals(1.9);
+        std::poisson_distribution<> healerArrivals(2.0);
+        std::poisson_distribution<> dpsArrivals(6.6);
+        std::bernoulli_distribution boosted(boostedShare);
+
+        RoleQueue queues[ROLE_COUNT];
+        for (auto& queue : queues) {
+            queue.policy = policy;
+            queue.agingRate = agingRate;
+        }
+
+        const Clock::time_point start = Clock::time_point();
+        std::vector<double> waits;
+        std::vector<double> dpsWaits;
+        std::chrono::duration<double> matchTime(0);
+        int nextId = 1;
+        long long parties = 0;
+
+        for (int tick = 0; tick < ticks; tick++) {
+            Clock::time_point now = start + std::chrono::seconds(tick);
+            std::poisson_distribution<>* arrivals[ROLE_COUNT] = { &tankArrivals, &healerArrivals, &dpsArrivals };
+            for (int role = 0; role < ROLE_COUNT; role++) {
+                int count = (*arrivals[role])(gen);
+                for (int i = 0; i < count; i++) {
+                    queues[role].push(Player(nextId++, static_cast<Role>(role), now,
+                        boosted(gen) ? boostSeconds : 0.0));
+                }
+            }
+
+            auto matchStart = std::chrono::high_resolution_clock::now();
+            int formed = 0;
+            while (formed < partiesPerTick && queues[TANK].size() >= 1 && queues[HEALER].size() >= 1 && queues[DPS].size() >= 3) {
+                const Role slots[5] = { TANK, HEALER, DPS, DPS, DPS };
+                for (Role role : slots) {
+                    Player player = queues[role].pop();
+                    double wait = std::chrono::duration<double>(now - player.joinTime).count();
+                    waits.push_back(wait);
+                    if (role == DPS) dpsWaits.push_back(wait);
+                }
+                formed++;
+            }
+            matchTime += std::chrono::high_resolution_clock::now() - matchStart;
+            parties += formed;
         }
+
+        // Players still queued have waited at least this long; count them so starvation shows up
+        Clock::time_point end = start + std::chrono::seconds(ticks);
+        for (int role = 0; role < ROLE_COUNT; role++) {
+            while (queues[role].size() > 0) {
+                Player player = queues[role].pop();
+                double wait = std::chrono::duration<double>(end - player.joinTime).count();
+                waits.push_back(wait);
+                if (player.role == DPS) dpsWaits.push_back(wait);
+            }
+        }
+
+        std::cout << std::left << std::setw(8) << fairnessPolicyName(policy) << std::right << std::fixed << std::setprecision(0)
+            << std::setw(12) << percentile(waits, 1.0)
+            << std::setw(12) << percentile(waits, 0.99)
+            << std::setw(12) << percentile(dpsWaits, 1.0)
+            << std::setprecision(3) << std::setw(10) << jainIndex(waits)
+            << std::setprecision(0) << std::setw(16) << (matchTime.count() > 0 ? parties / matchTime.count() : 0.0)
+            << std::endl;
     }
-    return -1; // No available instance
+    std::cout << "(waits in virtual seconds, " << ticks << " ticks, " << partiesPerTick << " parties/tick)" << std::endl;
+    std::cout << "===============================" << std::endl;
 }
 
-void displayStatus() {
-    std::lock_guard<std::mutex> lock(instancesMutex);
-    std::cout << "\n===== Current Instance Status =====" << std::endl;
-    for (const auto& instance : instances) {
-        std::cout << "Instance " << instance.id << ": "
-            << (instance.active ? "active" : "empty") << std::endl;
+InstancePolicy parseInstancePolicy(const std::string& name) {
+    if (name == "round-robin") return InstancePolicy::RoundRobin;
+    if (name == "least-utilised") return InstancePolicy::LeastUtilised;
+    if (name == "most-recently-freed") return InstancePolicy::MostRecentlyFreed;
+    if (name == "power-of-two") return InstancePolicy::PowerOfTwo;
+    if (name != "lowest-index") {
+        std::cerr << "Warning: Unknown instance-policy '" << name << "' in config file. Using lowest-index." << std::endl;
     }
+    return InstancePolicy::LowestIndex;
+}
 
-    {
-        std::lock_guard<std::mutex> qLock(queueMutex);
-        std::cout << "\nQueue Status:" << std::endl;
-        std::cout << "Tanks: " << tanksAvailable << std::endl;
-        std::cout << "Healers: " << healersAvailable << std::endl;
-        std::cout << "DPS: " << dpsAvailable << std::endl;
-        std::cout << "===============================" << std::endl;
+const char* instancePolicyName(InstancePolicy policy) {
+    switch (policy) {
+    case InstancePolicy::RoundRobin: return "round-robin";
+    case InstancePolicy::LeastUtilised: return "least-utilised";
+    case InstancePolicy::MostRecentlyFreed: return "most-recently-freed";
+    case InstancePolicy::PowerOfTwo: return "power-of-two";
+    default: return "lowest-index";
     }
 }
 
-void runInstance(int instanceId) {
-    int clearTime = getRandomClearTime();
+// Runs a half-loaded fleet on a virtual clock: each tick a few parties arrive and
+// take a free instance, and busy instances free up when their clear time elapses.
+// Reports the cost of one acquire/release pair and how evenly work was spread.
+template <typename Selector>
+void benchmarkSelector(const char* name, int numInstances) {
+    const int ticks = 200000;
+    std::mt19937 gen(777);
+    std::uniform_int_distribution<> clearTimes(4, 15);
+    std::poisson_distribution<> arrivals(numInstances / 2.0 / 9.5);
 
-    {
-        std::lock_guard<std::mutex> lock(instancesMutex);
-        instances[instanceId].active = true;
-        std::cout << "\n> Party entering Instance " << instances[instanceId].id << std::endl;
-    }
+    std::vector<Instance> fleet;
+    for (int i = 0; i < numInstances; i++) fleet.push_back(Instance(i + 1));
 
-    displayStatus();
+    Selector selector;
+    for (int i = numInstances - 1; i >= 0; i--) selector.release(i, fleet[i]);
 
-    std::this_thread::sleep_for(std::chrono::seconds(clearTime));
+    typedef std::pair<int, int> Completion; // (tick, index)
+    std::priority_queue<Completion, std::vector<Completion>, std::greater<Completion>> busy;
+    std::chrono::duration<double> selectTime(0);
+    long long dispatches = 0;
 
-    {
-        std::lock_guard<std::mutex> lock(instancesMutex);
-        instances[instanceId].active = false;
-        instances[instanceId].partiesServed++;
-        instances[instanceId].totalTimeServed += std::chrono::seconds(clearTime);
-        std::cout << "\n> Party completed Instance " << instances[instanceId].id << " in "
-            << clearTime << " seconds" << std::endl;
+    for (int tick = 0; tick < ticks; tick++) {
+        int arriving = arrivals(gen);
+        auto selectStart = std::chrono::high_resolution_clock::now();
+        while (!busy.empty() && busy.top().first <= tick) {
+            selector.release(busy.top().second, fleet[busy.top().second]);
+            busy.pop();
+        }
+        int acquired[64];
+        int count = 0;
+        for (int i = 0; i < arriving && count < 64; i++) {
+            int index = selector.acquire();
+            if (index == -1) break;
+            acquired[count++] = index;
+        }
+        selectTime += std::chrono::high_resolution_clock::now() - selectStart;
+
+        for (int i = 0; i < count; i++) {
+            int clearTime = clearTimes(gen);
+            fleet[acquired[i]].partiesServed++;
+            fleet[acquired[i]].totalTimeServed += std::chrono::seconds(clearTime);
+            busy.push(Completion(tick + clearTime, acquired[i]));
+        }
+        dispatches += count;
     }
 
-    cv.notify_all();
+    double mean = 0.0;
+    long long least = fleet[0].totalTimeServed.count();
+    long long most = least;
+    for (const auto& instance : fleet) {
+        mean += instance.totalTimeServed.count();
+        least = std::min(least, static_cast<long long>(instance.totalTimeServed.count()));
+        most = std::max(most, static_cast<long long>(instance.totalTimeServed.count()));
+    }
+    mean /= numInstances;
+    double variance = 0.0;
+    for (const auto& instance : fleet) {
+        double diff = instance.totalTimeServed.count() - mean;
+        variance += diff * diff;
+    }
+    double wearCv = mean > 0 ? std::sqrt(variance / numInstances) / mean : 0.0;
+
+    std::cout << std::left << std::setw(22) << name << std::right << std::fixed
+        << std::setprecision(1) << std::setw(14) << (dispatches > 0 ? selectTime.count() * 1e9 / dispatches : 0.0)
+        << std::setprecision(3) << std::setw(12) << wearCv
+        << std::setw(12) << least << std::setw(12) << most << std::endl;
 }
 
-void queueManager() {
-    std::vector<std::thread> instanceThreads;
+void benchmarkInstanceSelection() {
+    const int fleetSizes[] = { 64, 4096 };
+    for (int numInstances : fleetSizes) {
+        std::cout << "\n===== Instance Selection Benchmark (" << numInstances << " instances, ~50% load) =====" << std::endl;
+        std::cout << std::left << std::setw(22) << "policy" << std::right << std::setw(14) << "ns/dispatch"
+            << std::setw(12) << "wear cv" << std::setw(12) << "min served" << std::setw(12) << "max served" << std::endl;
+        benchmarkSelector<LowestIndexSelector>("lowest-index", numInstances);
+        benchmarkSelector<RoundRobinSelector>("round-robin", numInstances);
+        benchmarkSelector<LeastUtilisedSelector>("least-utilised", numInstances);
+        benchmarkSelector<MostRecentlyFreedSelector>("most-recently-freed", numInstances);
+    }
+    std::cout << "(wear cv: coefficient of variation of seconds served per instance, lower is more even)" << std::endl;
+    std::cout << "===============================" << std::endl;
+}
 
-    while (!shutdown) {
-        if (canFormParty()) {
-            // Get an instance ID while holding the mutex
-            int instanceId = -1;
-            {
-                std::lock_guard<std::mutex> lock(instancesMutex);
-                // Available instance
-                for (int i = 0; i < static_cast<int>(instances.size()); i++) {
-                    if (!instances[i].active) {
-                        instanceId = i;
-                        instances[i].active = true;  // Mark as active
-                        break;
-                    }
-                }
-            }
+// A 90%-loaded sharded fleet on a virtual clock. Times every acquire for tail
+// dispatch latency and compares the busiest shard with the
+// mean shard load every ten ticks to show how evenly the policy spreads work.
+template <typename Selector>
+void benchmarkShardDispatch(const char* name, int numInstances, int shardCount) {
+    const int ticks = 4000000 / numInstances; // ~400k dispatches whatever the fleet size
+    std::mt19937 gen(60);
+    std::uniform_int_distribution<> clearTimes(4, 15);
+    std::poisson_distribution<> arrivals(numInstances * 0.9 / 9.5);
 
-            if (instanceId != -1) {
-                // Form a party and remove players from the queue
-                formParty();
+    std::vector<Instance> fleet;
+    for (int i = 0; i < numInstances; i++) fleet.push_back(Instance(i + 1));
+    Selector selector = makeSelector<Selector>(shardCount);
+    for (int i = numInstances - 1; i >= 0; i--) selector.release(i, fleet[i]);
 
-                instanceThreads.push_back(std::thread(runInstance, instanceId));
-            }
-            else {
-                // Wait for an instance to become available
-                std::unique_lock<std::mutex> lock(instancesMutex);
-                cv.wait(lock, []() {
-                    for (const auto& instance : instances) {
-                        if (!instance.active) return true;
-                    }
-                    return false;
-                });
-            }
-        }
-        else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::vector<int> shardBusy(shardCount, 0);
+    typedef std::pair<int, int> Completion;
+    std::priority_queue<Completion, std::vector<Completion>, std::greater<Completion>> busy;
+    std::vector<double> dispatchNs;
+    double imbalanceTotal = 0.0;
+    long long samples = 0;
 
-            // Check if no parties can form
-            if (!canFormParty()) {
-                // Check if any instances are still active
-                bool anyActive = false;
-                {
-                    std::lock_guard<std::mutex> lock(instancesMutex);
-                    for (const auto& instance : instances) {
-                        if (instance.active) {
-                            anyActive = true;
-                            break;
-                        }
-                    }
-                }
+    for (int tick = 0; tick < ticks; tick++) {
+        while (!busy.empty() && busy.top().first <= tick) {
+            int index = busy.top().second;
+            busy.pop();
+            selector.release(index, fleet[index]);
+            shardBusy[index % shardCount]--;
+        }
+        int arriving = arrivals(gen);
+        for (int i = 0; i < arriving; i++) {
+            auto start = std::chrono::high_resolution_clock::now();
+            int index = selector.acquire();
+            auto end = std::chrono::high_resolution_clock::now();
+            if (index == -1) break;
+            dispatchNs.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+            shardBusy[index % shardCount]++;
+            busy.push(Completion(tick + clearTimes(gen), index));
+        }
 
-                // Only shut down if no active instances and no parties can form
-                if (!anyActive) {
-                    shutdown = true;
-                }
+        if (tick % 10 == 0) {
+            int busiest = *std::max_element(shardBusy.begin(), shardBusy.end());
+            double mean = static_cast<double>(busy.size()) / shardCount;
+            if (mean > 0) {
+                imbalanceTotal += busiest / mean;
+                samples++;
             }
         }
     }
 
-    // Join all instance threads before exiting
-    for (auto& t : instanceThreads) {
-        if (t.joinable()) {
-            t.join();
-        }
+    std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(0)
+        << std::setw(10) << percentile(dispatchNs, 0.5) << std::setw(10) << percentile(dispatchNs, 0.99)
+        << std::setw(10) << percentile(dispatchNs, 0.999) << std::setw(12) << percentile(dispatchNs, 1.0)
+        << std::setprecision(3) << std::setw(14) << (samples > 0 ? imbalanceTotal / samples : 0.0) << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+}
+
+void benchmarkDispatch() {
+    const int configs[][2] = { { 1024, 16 }, { 4096, 64 } };
+    for (const auto& config : configs) {
+        std::cout << "\n===== Shard Dispatch Benchmark (" << config[0] << " instances, " << config[1]
+            << " shards, ~90% load) =====" << std::endl;
+        std::cout << std::left << std::setw(16) << "policy" << std::right << std::setw(10) << "p50 ns"
+            << std::setw(10) << "p99 ns" << std::setw(10) << "p99.9 ns" << std::setw(12) << "max ns"
+            << std::setw(14) << "max/mean load" << std::endl;
+        benchmarkShardDispatch<FirstFitSelector>("first-fit", config[0], config[1]);
+        benchmarkShardDispatch<RandomShardSelector>("random shard", config[0], config[1]);
+        benchmarkShardDispatch<PowerOfTwoSelector>("power-of-two", config[0], config[1]);
     }
+    std::cout << "(max/mean load: busiest shard's busy instances over the mean, 1.000 is perfectly even)" << std::endl;
+    std::cout << "===============================" << std::endl;
 }
 
-void displaySummary() {
-    std::lock_guard<std::mutex> lock(instancesMutex);
-    std::cout << "\n===== Instance Summary =====" << std::endl;
-    for (const auto& instance : instances) {
-        std::cout << "Instance " << instance.id << ":" << std::endl;
-        std::cout << "  Parties served: " << instance.partiesServed << std::endl;
-        std::cout << "  Total time served: " << instance.totalTimeServed.count() << " seconds" << std::endl;
+// Parties arrive as a Poisson stream on a virtual clock, each wanting one of
+// eight dungeons with skewed popularity. Dispatch latency is the time from a party
+// being formed to its instance being ready: queueing for a free instance plus startup.
+void benchmarkWarmupStrategy(const char* name, int poolSize, bool affinity, double arrivalRate) {
+    const int numInstances = 32;
+    const int numDungeons = 8;
+    const double horizon = 200000.0;
+    std::mt19937 gen(4242);
+    std::exponential_distribution<> arrivalGaps(arrivalRate);
+    std::discrete_distribution<> dungeonPick({ 30, 20, 15, 10, 10, 7, 5, 3 });
+    std::uniform_int_distribution<> clearTimes(4, 15);
+
+    std::vector<Instance> fleet;
+    for (int i = 0; i < numInstances; i++) fleet.push_back(Instance(i + 1));
+    WarmPool<LowestIndexSelector> pool(1);
+    pool.coldStartTime = 6.0;
+    pool.mapLoadTime = 1.5;
+    pool.affinity = affinity;
+    pool.init(numDungeons, poolSize);
+    pool.fill(fleet);
+
+    typedef std::pair<double, int> Completion;
+    std::priority_queue<Completion, std::vector<Completion>, std::greater<Completion>> busy;
+    std::deque<std::pair<double, int>> waiting; // (formed at, dungeon)
+    std::vector<double> latencies;
+    int counts[3] = { 0, 0, 0 };
+    double now = 0.0;
+    double nextArrival = arrivalGaps(gen);
+
+    while (nextArrival < horizon || !busy.empty()) {
+        if (!busy.empty() && (busy.top().first <= nextArrival || nextArrival >= horizon)) {
+            now = busy.top().first;
+            pool.release(busy.top().second, fleet[busy.top().second]);
+            busy.pop();
+        }
+        else {
+            now = nextArrival;
+            waiting.push_back(std::make_pair(now, dungeonPick(gen)));
+            nextArrival = now + arrivalGaps(gen);
+        }
+
+        while (!waiting.empty()) {
+            Startup startup;
+            int index = pool.acquire(waiting.front().second, fleet, startup);
+            if (index == -1) break;
+            double cost = pool.startupCost(startup);
+            latencies.push_back(now + cost - waiting.front().first);
+            counts[static_cast<int>(startup)]++;
+            busy.push(Completion(now + cost + clearTimes(gen), index));
+            waiting.pop_front();
+        }
     }
 
-    int totalParties = 0;
-    std::chrono::seconds totalTime(0);
-    for (const auto& instance : instances) {
-        totalParties += instance.partiesServed;
-        totalTime += instance.totalTimeServed;
+    double mean = 0.0;
+    for (double latency : latencies) mean += latency;
+    mean /= latencies.size();
+    std::cout << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(2)
+        << std::setw(10) << mean << std::setw(10) << percentile(latencies, 0.99)
+        << std::setw(10) << 100.0 * counts[static_cast<int>(Startup::ColdStart)] / latencies.size()
+        << std::setw(10) << 100.0 * counts[static_cast<int>(Startup::MapLoad)] / latencies.size()
+        << std::setprecision(0) << std::setw(14) << latencies.size() / (now / 3600.0) << std::endl;
+}
+
+void benchmarkWarmup() {
+    // ~70% of capacity, then enough arrivals to keep every instance busy
+    const double arrivalRates[] = { 2.0, 4.0 };
+    for (double arrivalRate : arrivalRates) {
+        std::cout << "\n===== Warm-up Benchmark (32 instances, cold start 6s, map load 1.5s, "
+            << arrivalRate << " parties/s) =====" << std::endl;
+        std::cout << std::left << std::setw(20) << "strategy" << std::right << std::setw(10) << "mean"
+            << std::setw(10) << "p99" << std::setw(10) << "cold %" << std::setw(10) << "load %"
+            << std::setw(14) << "parties/hour" << std::endl;
+        benchmarkWarmupStrategy("cold", 0, true, arrivalRate);
+        benchmarkWarmupStrategy("warm-8", 8, false, arrivalRate);
+        benchmarkWarmupStrategy("warm-8 affinity", 8, true, arrivalRate);
+        benchmarkWarmupStrategy("warm-32", 32, false, arrivalRate);
+        benchmarkWarmupStrategy("warm-32 affinity", 32, true, arrivalRate);
+        std::cout.unsetf(std::ios::fixed);
     }
+    std::cout << "(mean/p99: dispatch latency in virtual seconds)" << std::endl;
+    std::cout << "===============================" << std::endl;
+}
 
-    std::cout << "\nOverall Summary:" << std::endl;
-    std::cout << "  Total parties served: " << totalParties << std::endl;
-    std::cout << "  Total time served across all instances: " << totalTime.count() << " seconds" << std::endl;
+// One party per second on a virtual clock against a fleet of the given size. Crashed
+// runs put the party back at the head of the line and take the instance out for
+// `recovery` seconds. A party's wait is all the time it spends queued, including
+// queueing again after crashes, and is checked against a 30s SLO.
+void benchmarkFailureCase(int numInstances, double crashChance, double recovery) {
+    const double horizon = 200000.0;
+    const double waitSlo = 30.0;
+    std::mt19937 gen(9001);
+    std::exponential_distribution<> arrivalGaps(1.0);
+    std::uniform_int_distribution<> clearTimes(4, 15);
+    std::bernoulli_distribution crashes(crashChance);
+    std::uniform_real_distribution<> unit(0.0, 1.0);
 
-    {
-        std::lock_guard<std::mutex> qLock(queueMutex);
-        std::cout << "\nLeftover Players:" << std::endl;
-        std::cout << "  Tanks: " << tanksAvailable << std::endl;
-        std::cout << "  Healers: " << healersAvailable << std::endl;
-        std::cout << "  DPS: " << dpsAvailable << std::endl;
+    enum EventKind { Finish, Crash, Recover };
+    struct Event {
+        double time;
+        EventKind kind;
+        int party;
+        bool operator>(const Event& other) const { return time > other.time; }
+    };
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    std::vector<double> formedAt;
+    std::vector<double> waited;
+    std::deque<int> waiting;
+    std::deque<int> requeued;
+    std::vector<double> recoveryLatency;
+    std::vector<double> crashedAt;
+    int freeInstances = numInstances;
+    double lost = 0.0;
+    double played = 0.0;
+    double now = 0.0;
+    double nextArrival = arrivalGaps(gen);
+    std::vector<double> enqueuedAt;
 
-        int maxPossibleParties = std::min({ tanksAvailable, healersAvailable, dpsAvailable / 3 });
-        if (maxPossibleParties > 0) {
-            std::cout << "  Note: " << maxPossibleParties << " more parties could have been formed," << std::endl;
-            std::cout << "        but there weren't enough instances available." << std::endl;
+    while (nextArrival < horizon || !events.empty()) {
+        if (!events.empty() && (events.top().time <= nextArrival || nextArrival >= horizon)) {
+            Event event = events.top();
+            events.pop();
+            now = event.time;
+            if (event.kind == Crash) {
+                crashedAt[event.party] = now;
+                enqueuedAt[event.party] = now;
+                requeued.push_back(event.party);
+                events.push(Event{ now + recovery, Recover, -1 });
+            }
+            else {
+                freeInstances++;
+            }
         }
         else {
-            int totalLeftover = tanksAvailable + healersAvailable + dpsAvailable;
-            if (totalLeftover > 0) {
-                std::cout << "  These players couldn't form complete parties due to role imbalance." << std::endl;
+            now = nextArrival;
+            formedAt.push_back(now);
+            enqueuedAt.push_back(now);
+            waited.push_back(0.0);
+            crashedAt.push_back(-1.0);
+            waiting.push_back(static_cast<int>(formedAt.size()) - 1);
+            nextArrival = now + arrivalGaps(gen);
+        }
+
+        while (freeInstances > 0 && (!requeued.empty() || !waiting.empty())) {
+            std::deque<int>& line = requeued.empty() ? waiting : requeued;
+            int party = line.front();
+            line.pop_front();
+            freeInstances--;
+            waited[party] += now - enqueuedAt[party];
+            if (crashedAt[party] >= 0) recoveryLatency.push_back(now - crashedAt[party]);
+
+            int clearTime = clearTimes(gen);
+            if (crashes(gen)) {
+                double crashAfter = unit(gen) * clearTime;
+                lost += crashAfter;
+                events.push(Event{ now + crashAfter, Crash, party });
             }
             else {
-                std::cout << "  No leftover players - all players were assigned to parties." << std::endl;
+                played += clearTime;
+                events.push(Event{ now + clearTime, Finish, party });
             }
         }
     }
 
+    int breaches = 0;
+    for (double wait : waited) {
+        if (wait > waitSlo) breaches++;
+    }
+    double recoveryMean = 0.0;
+    for (double latency : recoveryLatency) recoveryMean += latency;
+    if (!recoveryLatency.empty()) recoveryMean /= recoveryLatency.size();
+
+    std::cout << std::right << std::fixed << std::setprecision(2)
+        << std::setw(8) << crashChance << std::setw(8) << numInstances
+        << std::setprecision(1) << std::setw(10) << percentile(waited, 0.99)
+        << std::setprecision(2) << std::setw(10) << 100.0 * breaches / waited.size()
+        << std::setw(12) << 100.0 * lost / (lost + played)
+        << std::setprecision(1) << std::setw(12) << recoveryMean << std::endl;
+}
+
+void benchmarkFailures() {
+    // 1 party/s at a mean clear of 9.5s keeps 9.5 instances busy before any crashes
+    const double crashChances[] = { 0.0, 0.02, 0.1, 0.25 };
+    const int fleetSizes[] = { 11, 12, 14, 16, 20 };
+    const double recovery = 60.0;
+    std::cout << "\n===== Failure Benchmark (1 party/s, clear 4-15s, recovery " << recovery << "s, SLO 30s) =====" << std::endl;
+    std::cout << std::right << std::setw(8) << "crash p" << std::setw(8) << "fleet" << std::setw(10) << "p99 wait"
+        << std::setw(10) << "% > SLO" << std::setw(12) << "work lost %" << std::setw(12) << "recovery" << std::endl;
+    for (double crashChance : crashChances) {
+        for (int numInstances : fleetSizes) {
+            benchmarkFailureCase(numInstances, crashChance, recovery);
+        }
+    }
+    std::cout.unsetf(std::ios::fixed);
+    std::cout << "(waits and recovery latency in virtual seconds)" << std::endl;
     std::cout << "===============================" << std::endl;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     int n = 0; // Max num of concurrent instances
     int t = 0; // num of tank players in queue
     int h = 0; // num of healer players in the queue
@@ -314,29 +7310,197 @@ int main() {
 
     readConfig(&n, &t, &h, &d, &t1, &t2);
 
+    // An unset seed is drawn here and printed with the inputs, so any run can be replayed
+    if (rngSeed == 0) {
+        std::random_device rd;
+        rngSeed = (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+    initAdmission();
+
+    if (argc > 1 && std::string(argv[1]) == "--bench-fairness") {
+        benchmarkFairness();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-instances") {
+        benchmarkInstanceSelection();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-dispatch") {
+        benchmarkDispatch();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-warmup") {
+        benchmarkWarmup();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-failures") {
+        benchmarkFailures();
+        return 0;
+    }
+    if (argc > 2 && std::string(argv[1]) == "--read-events") {
+        readEventLog(argv[2]);
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--bench-joins") {
+        benchmarkJoins();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-locks") {
+        benchmarkLocks();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-skill") {
+        benchmarkSkillMatching();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-admission") {
+        benchmarkAdmission();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-batch") {
+        benchmarkBatching();
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-sampling") {
+        return benchmarkSampling();
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench-sim") {
+        benchmarkSimulation(simThreads > 0 ? simThreads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--simulate") {
+        // Sized like the daemon default, ~75% of what the simulated fleet clears,
+        // less the half of finished players the simulator queues again
+        Scenario model;
+        double meanPerSecond = arrivalRate > 0 ? arrivalRate : 0.75 * simInstances / ((t1 + t2) / 2.0) * PARTY_SIZE / 2;
+        if (arrivalModel != ArrivalModel::Steady && !buildArrivalScenario(meanPerSecond, t, h, d, model)) return 1;
+        return runSimulation(argc > 2 ? argv[2] : "time-warp", t1, t2, arrivalModel != ArrivalModel::Steady ? &model : nullptr);
+    }
+    if (argc > 2 && std::string(argv[1]) == "--shadow") {
+        if (n <= 0 || t <= 0 || h <= 0 || d <= 0 || t1 <= 0 || t2 <= t1) {
+            std::cerr << "Error: --shadow needs max-num-instances, num-tank/healer/dps weights and min-time < max-time in config.txt" << std::endl;
+            return 1;
+        }
+        maxInstances = n;
+        minTime = t1;
+        maxTime = std::min(t2, 15);
+        publishConfig(configFromGlobals());
+        return runShadow(std::vector<std::string>(argv + 2, argv + argc), n, t, h, d);
+    }
+    if (argc > 2 && std::string(argv[1]) == "--host") {
+        maxInstances = n > 0 ? n : 1;
+        minTime = t1;
+        maxTime = std::min(t2, 15);
+        if (t <= 0 || h <= 0 || d <= 0 || minTime <= 0 || maxTime <= minTime) {
+            std::cerr << "Error: --host needs num-tank/healer/dps weights and min-time < max-time in config.txt as tenant defaults" << std::endl;
+            return 1;
+        }
+        publishConfig(configFromGlobals());
+        return runHost(argv[2], t, h, d);
+    }
+    if (argc > 3 && std::string(argv[1]) == "--compile-scenario") {
+        return compileScenario(argv[2], argv[3]) ? 0 : 1;
+    }
+    if (argc > 3 && std::string(argv[1]) == "--gen-joins") {
+        generateJoinFile(argv[2], std::atoll(argv[3]));
+        return 0;
+    }
+
+    double soakHours = 0.0;
+    if (argc > 1 && std::string(argv[1]) == "--daemon") {
+        daemonMode = true;
+    }
+    // --scenario <file> [real|accelerated|virtual [backend]]: real runs the engine in
+    // real time, accelerated at time-scale (a minute per second if unset), and
+    // virtual through the discrete-event simulator
+    if (argc > 2 && std::string(argv[1]) == "--scenario") {
+        std::string speed = argc > 3 ? argv[3] : "accelerated";
+        if (speed != "real" && speed != "accelerated" && speed != "virtual") {
+            std::cerr << "Error: Unknown scenario speed " << speed << " (real, accelerated or virtual)" << std::endl;
+            return 1;
+        }
+        if (!loadScenario(argv[2], scenario)) return 1;
+        if (speed == "virtual") return runSimulation(argc > 4 ? argv[4] : "conservative", t1, t2, &scenario);
+        scenarioLoaded = true;
+        daemonMode = true;
+        if (speed == "real") timeScale = 1.0;
+        else if (timeScale == 1.0) timeScale = 1.0 / 60;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--soak") {
+        soakHours = argc > 2 ? std::atof(argv[2]) : 4.0;
+        if (soakHours <= 0) soakHours = 4.0;
+        daemonMode = true;
+        displayMode = DisplayMode::Quiet;
+        if (timeScale == 1.0) timeScale = 1.0 / 720; // an engine hour every 5 real seconds
+    }
+
+    EventExporter exporter;
+    if (!eventLogPath.empty()) {
+        if (exporter.open(eventLogPath)) {
+            eventExporter = &exporter;
+        }
+        else {
+            std::cerr << "Warning: Could not open event log " << eventLogPath << ", events will not be exported." << std::endl;
+        }
+    }
+
     while (n <= 0) {
         std::cout << "Enter maximum number of concurrent instances (n, must be > 0): ";
         std::cin >> n;
         if (n <= 0) std::cout << "Error: n must be greater than 0." << std::endl;
     }
 
-    while (t <= 0) {
+    for (auto& queue : roleQueues) {
+        queue.policy = fairnessPolicy;
+        queue.agingRate = agingRate;
+    }
+
+    // A join file replaces the num-tank/num-healer/num-dps population. A role the file
+    // lacks stays empty rather than being prompted for, which would block a daemon on
+    // stdin. Daemon arrivals follow the file's role mix if it has every role, else
+    // the configured counts, else 1/1/3.
+    bool seededFromFile = false;
+    int weights[ROLE_COUNT] = { t, h, d };
+    if (!joinFilePath.empty() && ingestJoinFile(joinFilePath)) {
+        seededFromFile = true;
+        t = tanksAvailable;
+        h = healersAvailable;
+        d = dpsAvailable;
+        if (t > 0 && h > 0 && d > 0) {
+            weights[TANK] = t;
+            weights[HEALER] = h;
+            weights[DPS] = d;
+        }
+        else if (weights[TANK] <= 0 || weights[HEALER] <= 0 || weights[DPS] <= 0) {
+            weights[TANK] = 1;
+            weights[HEALER] = 1;
+            weights[DPS] = 3;
+        }
+    }
+
+    while (!seededFromFile && t <= 0) {
         std::cout << "Enter number of tank players in the queue (t, must be > 0): ";
         std::cin >> t;
         if (t <= 0) std::cout << "Error: t must be greater than 0." << std::endl;
     }
 
-    while (h <= 0) {
+    while (!seededFromFile && h <= 0) {
         std::cout << "Enter number of healer players in the queue (h, must be > 0): ";
         std::cin >> h;
         if (h <= 0) std::cout << "Error: h must be greater than 0." << std::endl;
     }
 
-    while (d <= 0) {
+    while (!seededFromFile && d <= 0) {
         std::cout << "Enter number of DPS players in the queue (d, must be > 0): ";
         std::cin >> d;
         if (d <= 0) std::cout << "Error: d must be greater than 0." << std::endl;
     }
+    if (!seededFromFile) {
+        weights[TANK] = t;
+        weights[HEALER] = h;
+        weights[DPS] = d;
+    }
 
     while (t1 <= 0) {
         std::cout << "Enter minimum time before an instance is finished (t1, must be > 0): ";
@@ -358,9 +7522,23 @@ int main() {
     maxInstances = n;
     minTime = t1;
     maxTime = t2;
-    tanksAvailable = t;
-    healersAvailable = h;
-    dpsAvailable = d;
+    int nextPlayerId = lastIngestedId + 1;
+    if (!seededFromFile) {
+        tanksAvailable = 0;
+        healersAvailable = 0;
+        dpsAvailable = 0;
+
+        // Everyone in the initial queue joined at startup
+        Clock::time_point joined = Clock::now();
+        const int counts[ROLE_COUNT] = { t, h, d };
+        for (int role = 0; role < ROLE_COUNT; role++) {
+            for (int i = 0; i < counts[role]; i++) {
+                Player player(nextPlayerId, static_cast<Role>(role), joined);
+                player.rating = drawRating(nextPlayerId++);
+                enqueuePlayer(player);
+            }
+        }
+    }
 
     // Display the input values
     std::cout << "\nInput Values:" << std::endl;
@@ -370,21 +7548,104 @@ int main() {
     std::cout << "Number of DPS players in the queue (d): " << d << std::endl;
     std::cout << "Minimum time before an instance is finished (t1): " << t1 << std::endl;
     std::cout << "Maximum time before an instance is finished (t2): " << t2 << std::endl;
+    std::cout << "Fairness policy: " << fairnessPolicyName(fairnessPolicy) << std::endl;
+    std::cout << "Instance policy: " << instancePolicyName(instancePolicy) << std::endl;
+    std::cout << "RNG seed: " << rngSeed << std::endl;
+    std::cout << "Dungeon types: " << dungeonTypes << ", cold start " << coldStartTime << "s, map load "
+        << mapLoadTime << "s, warm pool " << warmPoolSize << std::endl;
+    if (crashProbability > 0 || meanTimeToFailure > 0) {
+        std::cout << "Failure injection: crash probability " << crashProbability << ", mean time to failure "
+            << meanTimeToFailure << "s, recovery " << recoveryTime << "s" << std::endl;
+    }
 
     // Initialize instances
     for (int i = 0; i < maxInstances; i++) {
-        instances.push_back(Instance(i + 1));
+        if (!instances.push_back(Instance(i + 1))) {
+            std::cerr << "Error: Only " << InstanceTable::capacity << " instances fit in the instance table." << std::endl;
+            return 1;
+        }
     }
+    liveStats.init(InstanceTable::capacity, maxInstances);
 
-    displayStatus();
+    if (displayMode == DisplayMode::Log) {
+        displayStatus();
+    }
 
-    std::thread managerThread(queueManager);
+    if (daemonMode && !scenarioLoaded && arrivalModel != ArrivalModel::Steady) {
+        if (arrivalRate <= 0) arrivalRate = 0.75 * maxInstances / ((minTime + maxTime) / 2.0) * 5;
+        if (!buildArrivalScenario(arrivalRate, weights[TANK], weights[HEALER], weights[DPS], scenario)) return 1;
+        scenarioLoaded = true;
+        if (arrivalModel == ArrivalModel::Trace) std::cout << "Trace arrivals from " << arrivalTracePath << std::endl;
+        else std::cout << "Diurnal arrivals: mean " << arrivalRate << " joins per engine second, peak at " << diurnalPeakHour
+            << ":00, swing " << diurnalSwing << std::endl;
+    }
+    if (scenarioLoaded) {
+        std::cout << "Scenario: " << scenario.phases.size() << " phases over " << scenario.lengthMs() / 1000
+            << " engine seconds" << (scenario.repeats ? " repeating" : "") << ", peak " << scenario.peakRate() << " joins/min, time scale " << timeScale << std::endl;
+    }
+    else if (daemonMode) {
+        if (arrivalRate <= 0) {
+            // Default to ~75% of what the fleet can clear at the mean clear time
+            arrivalRate = 0.75 * maxInstances / ((minTime + maxTime) / 2.0) * 5;
+        }
+        std::cout << "Daemon mode: " << arrivalRate << " joins per engine second, time scale " << timeScale;
+        if (soakHours > 0) std::cout << ", soak " << soakHours << " engine hours";
+        else if (daemonDuration > 0) std::cout << ", stopping after " << daemonDuration << " engine seconds";
+        else std::cout << ", until SIGINT/SIGTERM";
+        std::cout << std::endl;
+    }
 
-    // Wait for all processing to finish
-    managerThread.join();
+    double dashboardCpu = 0.0;
+    int dashboardFrames = 0;
+    std::thread dashboardThread;
+    if (displayMode == DisplayMode::Dashboard) {
+        dashboardThread = std::thread(runDashboard, &dashboardCpu, &dashboardFrames);
+    }
+    std::thread logThread;
+    if (displayMode == DisplayMode::Log) {
+        logThread = std::thread(runLogWriter);
+    }
+    publishConfig(configFromGlobals());
+    Clock::time_point runStart = Clock::now();
+    engineStart = runStart;
+
+    int exitCode = 0;
+    if (daemonMode) {
+        exitCode = runDaemon(weights[TANK], weights[HEALER], weights[DPS], nextPlayerId, soakHours);
+    }
+    else {
+        std::thread managerThread(queueManager);
+
+        // Wait for all processing to finish
+        managerThread.join();
+    }
+
+    if (logThread.joinable()) {
+        logStop = true;
+        logThread.join();
+    }
+    if (dashboardThread.joinable()) {
+        dashboardStop = true;
+        dashboardThread.join();
+        double wall = std::chrono::duration<double>(Clock::now() - runStart).count();
+        std::cout << "\nDashboard: " << dashboardFrames << " frames at " << dashboardFps << " fps, "
+            << std::fixed << std::setprecision(1) << dashboardCpu * 1000 << " ms CPU ("
+            << std::setprecision(3) << (wall > 0 ? 100.0 * dashboardCpu / wall : 0.0) << "% of a core)" << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
 
     // Display the final summary
-    displaySummary();
+    if (soakHours <= 0) {
+        displaySummary();
+        printSkillReport();
+    }
 
-    return 0;
+    if (eventExporter != nullptr) {
+        eventExporter->close();
+        eventExporter = nullptr;
+        std::cout << "Event log: " << exporter.eventsWritten << " events, " << exporter.bytesWritten
+            << " bytes written to " << eventLogPath << std::endl;
+    }
+
+    return exitCode;
 }
\ No newline at end of file